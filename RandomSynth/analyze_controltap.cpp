@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include <atomic>
+#include "analyze_controltap.h"
+
+void AudioAnalyzeControlTap::update(void)
+{
+	audio_block_t *block;
+	int32_t sum = 0;
+	int32_t lo = 0, hi = 0;
+	uint64_t squares = 0;
+
+	block = receiveReadOnly(0);
+	if (block) {
+		lo = hi = block->data[0];
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			int32_t x = block->data[i];
+			sum += x;
+			squares += x * x;
+			if (x < lo) lo = x;
+			if (x > hi) hi = x;
+		}
+		release(block);
+	}
+	int16_t mean = sum / AUDIO_BLOCK_SAMPLES;
+	int32_t rms = sqrtf((float)squares / AUDIO_BLOCK_SAMPLES);
+
+	uint32_t seq = sequence;
+	sequence = seq + 1;
+	std::atomic_thread_fence(std::memory_order_release);
+	reading.mean = mean;
+	reading.min = lo;
+	reading.max = hi;
+	reading.rms = rms > 32767 ? 32767 : rms;
+	reading.blocks = reading.blocks + 1;
+	std::atomic_thread_fence(std::memory_order_release);
+	sequence = seq + 2;
+
+	int16_t *buffer = ring;
+	if (buffer && --ringCountdown <= 0) {
+		ringCountdown = ringDecimation;
+		uint32_t written = ringWritten;
+		buffer[written % ringLength] = mean;
+		std::atomic_thread_fence(std::memory_order_release);
+		ringWritten = written + 1;
+	}
+}
+
+ControlTapReading AudioAnalyzeControlTap::read() const
+{
+	ControlTapReading copy;
+	uint32_t before, after;
+	do {
+		before = sequence;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		copy.mean = reading.mean;
+		copy.min = reading.min;
+		copy.max = reading.max;
+		copy.rms = reading.rms;
+		copy.blocks = reading.blocks;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = sequence;
+	} while ((before & 1) || before != after);
+	return copy;
+}
+
+void AudioAnalyzeControlTap::history(int16_t *memory, int length, int decimation)
+{
+	// stop the ring while it is repointed
+	ring = NULL;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	ringLength = length;
+	ringDecimation = decimation < 1 ? 1 : decimation;
+	ringWritten = 0;
+	ringCountdown = 0;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (memory && length > 0) ring = memory;
+}
+
+int AudioAnalyzeControlTap::readHistory(int16_t *out, int count) const
+{
+	const int16_t *buffer = ring;
+	const uint32_t length = ringLength;
+	if (!buffer || count <= 0) return 0;
+	uint32_t before = ringWritten;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint32_t n = count;
+	if (n > before) n = before;
+	if (n > length) n = length;
+	for (uint32_t k = 0; k < n; k++) {
+		out[k] = buffer[(before - n + k) % length];
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	// entries written meanwhile overwrote the oldest slots, which may be
+	// the first ones copied
+	uint32_t written = ringWritten - before;
+	if (written <= length - n) return n;
+	uint32_t lost = written - (length - n);
+	if (lost >= n) return 0;
+	memmove(out, out + lost, (n - lost) * sizeof(int16_t));
+	return n - lost;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <Arduino.h>
+#include <AudioStream.h>
+
+// Mean, extremes and RMS of one audio block, as read by control code
+struct ControlTapReading {
+  int16_t mean;
+  int16_t min;
+  int16_t max;
+  int16_t rms;
+  uint32_t blocks;  // blocks analysed so far, to tell a fresh reading
+};
+
+// Hands audio-rate modulation to loop() without tearing. The audio update
+// writes each block's reading under a sequence count and read() retries
+// until it gets a copy no update landed in the middle of. Nothing is
+// transmitted, so the tap costs no audio memory.
+//
+// With history() the mean of every few blocks also goes into a ring, for
+// control code that wants the shape of the signal rather than its latest
+// value.
+class AudioAnalyzeControlTap : public AudioStream {
+public:
+  AudioAnalyzeControlTap()
+    : AudioStream(1, inputQueueArray) {}
+
+  virtual void update(void);
+
+  // The last block's reading. A missing input block reads as silence.
+  ControlTapReading read() const;
+
+  // Keeps the mean of every `decimation` blocks in `memory`, overwriting
+  // the oldest. NULL stops it.
+  void history(int16_t *memory, int length, int decimation = 1);
+
+  // Up to count of the most recent history entries, oldest first. Returns
+  // how many were copied.
+  int readHistory(int16_t *out, int count) const;
+
+private:
+  audio_block_t *inputQueueArray[1];
+  volatile uint32_t sequence = 0;  // odd while update() is writing
+  volatile ControlTapReading reading = {};
+  int16_t *volatile ring = NULL;
+  volatile int ringLength = 0;
+  volatile int ringDecimation = 1;
+  volatile uint32_t ringWritten = 0;  // entries written since history()
+  int ringCountdown = 0;
+};
@@ -0,0 +1,52 @@
+#include <Arduino.h>
+#include "delay_line_pool.h"
+
+void DelayLinePool::begin(int16_t *memory, uint32_t samples) {
+  this->memory = memory;
+  numChunks = samples / DELAY_LINE_CHUNK_SAMPLES;
+  if (numChunks > DELAY_LINE_POOL_MAX_CHUNKS) numChunks = DELAY_LINE_POOL_MAX_CHUNKS;
+  usedChunks = 0;
+  usedChunksMax = 0;
+  memset(inUse, 0, sizeof(inUse));
+}
+
+void DelayLinePool::mark(uint32_t first, uint32_t count, bool used) {
+  for (uint32_t chunk = first; chunk < first + count; chunk++) {
+    if (used) {
+      inUse[chunk >> 5] |= 1u << (chunk & 31);
+    } else {
+      inUse[chunk >> 5] &= ~(1u << (chunk & 31));
+    }
+  }
+}
+
+int16_t *DelayLinePool::allocate(uint32_t samples) {
+  uint32_t count = chunksFor(samples);
+  if (!memory || count == 0 || count > numChunks) return NULL;
+
+  // First fit: find the first run of count free chunks
+  uint32_t runStart = 0, runLength = 0;
+  for (uint32_t chunk = 0; chunk < numChunks; chunk++) {
+    if (!isFree(chunk)) {
+      runLength = 0;
+      runStart = chunk + 1;
+      continue;
+    }
+    if (++runLength == count) {
+      mark(runStart, count, true);
+      usedChunks += count;
+      if (usedChunks > usedChunksMax) usedChunksMax = usedChunks;
+      return memory + runStart * DELAY_LINE_CHUNK_SAMPLES;
+    }
+  }
+  return NULL;
+}
+
+void DelayLinePool::release(int16_t *line, uint32_t samples) {
+  if (!line || !memory) return;
+  uint32_t first = (line - memory) / DELAY_LINE_CHUNK_SAMPLES;
+  uint32_t count = chunksFor(samples);
+  if (first + count > numChunks) return;
+  mark(first, count, false);
+  usedChunks -= count;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+
+#define DELAY_LINE_CHUNK_SAMPLES 32
+#define DELAY_LINE_POOL_MAX_CHUNKS 2048  // 64k samples, 128 KB
+
+// Hands out contiguous int16_t delay lines from one shared block of memory,
+// in 32 sample chunks. Used by the Karplus-Strong strings so each note only
+// holds as much delay line as its pitch needs.
+//
+// allocate() and release() are meant for note on/off in loop(); the audio
+// interrupt only ever touches the lines it has been handed.
+class DelayLinePool {
+public:
+  void begin(int16_t *memory, uint32_t samples);
+
+  // Returns a delay line of at least the requested length, or NULL if there
+  // is no contiguous run of free chunks left.
+  int16_t *allocate(uint32_t samples);
+  void release(int16_t *line, uint32_t samples);
+
+  uint32_t size() const {
+    return numChunks * DELAY_LINE_CHUNK_SAMPLES;
+  }
+  uint32_t used() const {
+    return usedChunks * DELAY_LINE_CHUNK_SAMPLES;
+  }
+  uint32_t usedMax() const {
+    return usedChunksMax * DELAY_LINE_CHUNK_SAMPLES;
+  }
+
+private:
+  static uint32_t chunksFor(uint32_t samples) {
+    return (samples + DELAY_LINE_CHUNK_SAMPLES - 1) / DELAY_LINE_CHUNK_SAMPLES;
+  }
+  bool isFree(uint32_t chunk) const {
+    return !(inUse[chunk >> 5] & (1u << (chunk & 31)));
+  }
+  void mark(uint32_t first, uint32_t count, bool used);
+
+  int16_t *memory = NULL;
+  uint32_t numChunks = 0;
+  uint32_t usedChunks = 0;
+  uint32_t usedChunksMax = 0;
+  uint32_t inUse[DELAY_LINE_POOL_MAX_CHUNKS / 32] = {};
+};
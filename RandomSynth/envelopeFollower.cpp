@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include "envelopeFollower.h"
+#include "utility/dspinst.h"
+
+// One sample of the one-pole, the attack coefficient while rising and the
+// release while falling. Both values are non-negative Q31, so the difference
+// cannot overflow.
+static inline int32_t follow(int32_t envelope, int32_t target, int32_t attack, int32_t release)
+{
+	int32_t diff = target - envelope;
+	return envelope + (multiply_32x32_rshift32(diff, diff > 0 ? attack : release) << 1);
+}
+
+void AudioEffectEnvelopeFollower::update(void)
+{
+	audio_block_t *in, *out;
+	const int32_t up = attackCoefficient;
+	const int32_t down = releaseCoefficient;
+	const int32_t window = windowCoefficient;
+	const bool squared = rmsMode;
+	int32_t env = envelope;
+	int32_t ms = meanSquare;
+
+	in = receiveReadOnly(0);
+	if (in) {
+		if (squared) {
+			for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+				int32_t x = in->data[i] * in->data[i];
+				// -32768 squared is the one value that does not fit Q31
+				x = x >= 0x40000000 ? 0x7FFFFFFF : x << 1;
+				ms = follow(ms, x, window, window);
+				env = follow(env, ms, up, down);
+			}
+		} else {
+			for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+				int32_t x = in->data[i];
+				x = x < 0 ? (x == -32768 ? 32767 : -x) : x;
+				env = follow(env, x << 16, up, down);
+			}
+		}
+		AudioStream::release(in);
+	} else if (env || ms) {
+		// no input is silence
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			ms = follow(ms, 0, window, window);
+			env = follow(env, squared ? ms : 0, up, down);
+		}
+	}
+	envelope = env;
+	meanSquare = ms;
+
+	int32_t from = level;
+	int32_t to;
+	if (squared) {
+		to = sqrtf(env * (1.0f / 2147483648.0f)) * 32767.0f;
+	} else {
+		to = env >> 16;
+	}
+	level = to;
+	if (from == 0 && to == 0) return;
+
+	out = allocate();
+	if (!out) return;
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		out->data[i] = from + (((to - from) * (i + 1)) >> 7);
+	}
+	transmit(out);
+	AudioStream::release(out);
+}
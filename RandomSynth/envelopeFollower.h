@@ -1,47 +1,61 @@
 #pragma once
+#include <Arduino.h>
 #include <AudioStream.h>
-#include <arm_math.h>  // For DSP functions, if needed
 
+// Follows the level of its input with separate attack and release times, in
+// fixed point, for driving modulation from audio. Peak mode follows the
+// rectified signal; RMS mode first averages the square over a window, then
+// follows that. A steady full scale sine reads about 0.9 in peak mode with
+// the default times, as the release droops between peaks, and 0.707 RMS.
+//
+// The level is followed every sample but reported once per block: read()
+// gives the latest value to control code, and output 0 ramps from the last
+// block's value to this one's, smooth enough for modulation and only one
+// square root per block in RMS mode. Nothing is sent while the level is 0.
 class AudioEffectEnvelopeFollower : public AudioStream {
 public:
   AudioEffectEnvelopeFollower()
-    : AudioStream(1, inputQueueArray) {}
+    : AudioStream(1, inputQueueArray) {
+    attack(10.0f);
+    release(200.0f);
+  }
 
-  virtual void update() {
-    audio_block_t *inBlock, *outBlock;
+  virtual void update(void);
 
-    // Get the input and output blocks
-    inBlock = receiveReadOnly(0);
-    if (!inBlock) return;
-    outBlock = allocate();
-    if (!outBlock) {
-      release(inBlock);
-      return;
-    }
+  // Time to move 63% of the way to a new level, rising and falling. In RMS
+  // mode this is of the mean square, so the level itself falls half as fast.
+  void attack(float milliseconds) {
+    attackCoefficient = coefficient(milliseconds);
+  }
+  void release(float milliseconds) {
+    releaseCoefficient = coefficient(milliseconds);
+  }
 
-    // Process each sample
-    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-      // Rectify the input signal
-      float rectified = fabs(inBlock->data[i]);
-      rectified = rectified - 200;
-      if (rectified < 0) rectified = 0;
-      rectified = rectified * 5;
-      Serial.println(rectified);
-      // Apply a simple low-pass filter for smoothing
-      // This is a very basic example; you might need a more sophisticated filter
-      env = (alpha * rectified) + ((1 - alpha) * env);
-      // Output the smoothed signal
-      outBlock->data[i] = env;
-    }
+  // Follow the RMS level over a window rather than peaks
+  void rms(bool enable, float windowMilliseconds = 20.0f) {
+    windowCoefficient = coefficient(windowMilliseconds);
+    rmsMode = enable;
+  }
 
-    // Transmit the block and release memory
-    transmit(outBlock);
-    release(inBlock);
-    release(outBlock);
+  // Level at the end of the last block, 0 to 1.0
+  float read() {
+    return level / 32767.0f;
   }
 
 private:
+  // One-pole coefficient for a time constant, Q31
+  static int32_t coefficient(float milliseconds) {
+    float samples = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f);
+    if (samples <= 1.0f) return 0x7FFFFFFF;
+    return (1.0f - expf(-1.0f / samples)) * 2147483647.0f;
+  }
+
   audio_block_t *inputQueueArray[1];
-  float env = 0;         // Envelope value
-  float alpha = 0.0001;  // Smoothing factor, adjust as needed
+  volatile int32_t attackCoefficient;
+  volatile int32_t releaseCoefficient;
+  volatile int32_t windowCoefficient = 0;
+  volatile bool rmsMode = false;
+  int32_t envelope = 0;  // Q31 of full scale, or of full scale squared for RMS
+  int32_t meanSquare = 0;  // Q31
+  volatile int16_t level = 0;
 };
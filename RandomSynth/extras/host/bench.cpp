@@ -0,0 +1,590 @@
+// Micro-benchmarks for the custom audio objects, a single Voice and
+// Synth<N> voice scaling.
+//
+//   randomsynth_bench [-n blocks] [filter]
+//
+// Every case runs in its own forked process, because audio objects register
+// themselves in the global update list for the lifetime of the program and
+// would otherwise keep running inside later cases. Results are the median
+// of several runs, in nanoseconds per 128 sample block; "cpu" is the share
+// of the 2.9 ms real-time budget one block has at 44.1 kHz.
+#include <Arduino.h>
+#include <synth.h>
+#include <synth_karplusstronger.h>
+#include <synth_wavetablemorph.h>
+#include <wavetables.h>
+#include <wavetable_file.h>
+#include <interpolate.h>
+#include <envelopeFollower.h>
+#include <analyze_controltap.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+static int benchBlocks = 20000;
+static const int benchRuns = 5;
+
+// Transmits the same block on every update, so feeding a node costs only a
+// reference count increment.
+class BenchSource : public AudioStream {
+public:
+  BenchSource() : AudioStream(0, NULL) {}
+  void begin(float frequency) {
+    block = allocate();
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      block->data[i] = 20000 * sinf(2.0f * PI * frequency * i / AUDIO_SAMPLE_RATE_EXACT);
+    }
+  }
+  virtual void update(void) {
+    if (block) transmit(block);
+  }
+private:
+  audio_block_t *block = NULL;
+};
+
+// Releases whatever it receives, standing in for the next object in a graph.
+class BenchSink : public AudioStream {
+public:
+  BenchSink() : AudioStream(1, inputQueueArray) {}
+  virtual void update(void) {
+    audio_block_t *block = receiveReadOnly(0);
+    if (block) release(block);
+  }
+private:
+  audio_block_t *inputQueueArray[1];
+};
+
+static void benchMemory(unsigned int blocks) {
+  static std::vector<audio_block_t> memory;
+  memory.resize(blocks);
+  AudioStream::initialize_memory(memory.data(), memory.size());
+}
+
+// Median ns per call of render(), after a warm-up.
+static double timeBlocks(const std::function<void()> &render) {
+  for (int i = 0; i < benchBlocks / 10; i++) render();
+  std::vector<double> runs;
+  for (int r = 0; r < benchRuns; r++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < benchBlocks; i++) render();
+    auto stop = std::chrono::steady_clock::now();
+    runs.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / benchBlocks);
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[benchRuns / 2];
+}
+
+// The string cases replay a note whenever a string has decayed to silence,
+// so they time ringing strings rather than ones that have stopped.
+static double benchKarplusStrong() {
+  benchMemory(16);
+  static AudioSynthKarplusStronger string;
+  static BenchSink sink;
+  static AudioConnection cord(string, sink);
+  static int16_t memory[AudioSynthKarplusStronger::MAX_BUFFER_LEN];
+  static DelayLinePool pool;
+  pool.begin(memory, AudioSynthKarplusStronger::MAX_BUFFER_LEN);
+  string.begin(&pool);
+  string.noteOn(220, 1);
+  return timeBlocks([] {
+    if (!string.isSounding()) string.noteOn(220, 1);
+    string.update();
+    sink.update();
+  });
+}
+
+// Same string with its pitch moving every block, as vibrato or a bend does,
+// so the fractional delay is retuned on each update.
+static double benchKarplusStrongGlide() {
+  benchMemory(16);
+  static AudioSynthKarplusStronger string;
+  static BenchSink sink;
+  static AudioConnection cord(string, sink);
+  static int16_t memory[AudioSynthKarplusStronger::MAX_BUFFER_LEN];
+  static DelayLinePool pool;
+  pool.begin(memory, AudioSynthKarplusStronger::MAX_BUFFER_LEN);
+  string.begin(&pool);
+  string.glide(20);
+  string.noteOn(220, 1);
+  return timeBlocks([] {
+    static int n = 0;
+    if (!string.isSounding()) string.noteOn(220, 1);
+    string.setPitch(220 + 10 * sinf(n++ * 0.05f));
+    string.update();
+    sink.update();
+  });
+}
+
+// Eight low strings restarted together on every block, the worst case for
+// excitation: a chord of note-ons landing in one update.
+static double benchKarplusStrongChord() {
+  benchMemory(32);
+  static AudioSynthKarplusStronger strings[8];
+  static BenchSink sinks[8];
+  static int16_t memory[8 * AudioSynthKarplusStronger::MAX_BUFFER_LEN];
+  static DelayLinePool pool;
+  pool.begin(memory, 8 * AudioSynthKarplusStronger::MAX_BUFFER_LEN);
+  for (int i = 0; i < 8; i++) {
+    new AudioConnection(strings[i], sinks[i]);
+    strings[i].begin(&pool);
+  }
+  return timeBlocks([] {
+    for (int i = 0; i < 8; i++) {
+      strings[i].noteOn(55 + 5 * i, 1);
+      strings[i].update();
+      sinks[i].update();
+    }
+  });
+}
+
+// Sixteen ringing strings as separate objects, then as one bank
+static double benchKarplusStrongSeparate() {
+  benchMemory(64);
+  static AudioSynthKarplusStronger strings[16];
+  static BenchSink sinks[16];
+  static int16_t memory[16 * AudioSynthKarplusStronger::MAX_BUFFER_LEN];
+  static DelayLinePool pool;
+  pool.begin(memory, 16 * AudioSynthKarplusStronger::MAX_BUFFER_LEN);
+  for (int i = 0; i < 16; i++) {
+    new AudioConnection(strings[i], sinks[i]);
+    strings[i].begin(&pool);
+    strings[i].noteOn(110 + 20 * i, 1);
+  }
+  return timeBlocks([] {
+    for (int i = 0; i < 16; i++) {
+      if (!strings[i].isSounding()) strings[i].noteOn(110 + 20 * i, 1);
+    }
+    AudioStream::update_all();
+  });
+}
+
+static double benchKarplusStrongBank() {
+  benchMemory(64);
+  static AudioSynthKarplusStrongBank<16> bank;
+  static BenchSink sinks[16];
+  static int16_t memory[16 * AudioSynthKarplusStronger::MAX_BUFFER_LEN];
+  static DelayLinePool pool;
+  pool.begin(memory, 16 * AudioSynthKarplusStronger::MAX_BUFFER_LEN);
+  bank.begin(&pool);
+  for (int i = 0; i < 16; i++) {
+    new AudioConnection(bank, i, sinks[i], 0);
+    bank.noteOn(i, 110 + 20 * i, 1);
+  }
+  return timeBlocks([] {
+    for (int i = 0; i < 16; i++) {
+      if (!bank.isSounding(i)) bank.noteOn(i, 110 + 20 * i, 1);
+    }
+    AudioStream::update_all();
+  });
+}
+
+// The double precision AudioInterpolate loop from before the Q14 kernel,
+// kept as the reference the new one is measured against.
+class BenchInterpolateReference : public AudioStream {
+public:
+  BenchInterpolateReference() : AudioStream(2, inputQueueArray) {}
+  float interpolationFactor = 0.5;
+  virtual void update(void) {
+    audio_block_t *block1 = receiveReadOnly(0);
+    audio_block_t *block2 = receiveReadOnly(1);
+    if (block1 && block2) {
+      audio_block_t *output = allocate();
+      if (output) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          int32_t interpolatedValue = (int32_t)(block1->data[i] * (1.0 - interpolationFactor)) + (int32_t)(block2->data[i] * interpolationFactor);
+          if (interpolatedValue > 32767) interpolatedValue = 32767;
+          else if (interpolatedValue < -32768) interpolatedValue = -32768;
+          output->data[i] = (int16_t)interpolatedValue;
+        }
+        transmit(output);
+        release(output);
+      }
+      release(block1);
+      release(block2);
+    } else {
+      if (block1) release(block1);
+      if (block2) release(block2);
+    }
+  }
+private:
+  audio_block_t *inputQueueArray[2];
+};
+
+static double benchInterpolateReference() {
+  benchMemory(16);
+  static BenchSource one, two;
+  static BenchInterpolateReference interpolate;
+  static BenchSink sink;
+  static AudioConnection cord1(one, 0, interpolate, 0);
+  static AudioConnection cord2(two, 0, interpolate, 1);
+  static AudioConnection cord3(interpolate, sink);
+  one.begin(220);
+  two.begin(330);
+  interpolate.interpolationFactor = 0.3;
+  return timeBlocks([] {
+    one.update();
+    two.update();
+    interpolate.update();
+    sink.update();
+  });
+}
+
+// The factor moves every block, as it does under aftertouch, so each block
+// is a ramp
+static double benchInterpolate(bool equalPower) {
+  benchMemory(16);
+  static BenchSource one, two;
+  static AudioInterpolate interpolate;
+  static BenchSink sink;
+  static AudioConnection cord1(one, 0, interpolate, 0);
+  static AudioConnection cord2(two, 0, interpolate, 1);
+  static AudioConnection cord3(interpolate, sink);
+  one.begin(220);
+  two.begin(330);
+  interpolate.equalPower(equalPower);
+  return timeBlocks([] {
+    static int n = 0;
+    interpolate.setInterpolationFactor(0.5f + 0.4f * sinf(n++ * 0.05f));
+    one.update();
+    two.update();
+    interpolate.update();
+    sink.update();
+  });
+}
+
+// Factor held at 1, so the second input is forwarded as it is
+static double benchInterpolatePassThrough() {
+  benchMemory(16);
+  static BenchSource one, two;
+  static AudioInterpolate interpolate;
+  static BenchSink sink;
+  static AudioConnection cord1(one, 0, interpolate, 0);
+  static AudioConnection cord2(two, 0, interpolate, 1);
+  static AudioConnection cord3(interpolate, sink);
+  one.begin(220);
+  two.begin(330);
+  interpolate.setInterpolationFactor(1);
+  return timeBlocks([] {
+    one.update();
+    two.update();
+    interpolate.update();
+    sink.update();
+  });
+}
+
+// The wavetable section as Voice used to build it: four oscillators, two
+// interpolators and a mixer, with the morph moving every block
+static double benchWavetableGraph() {
+  benchMemory(16);
+  static AudioSynthWaveformModulated oscillators[4];
+  static AudioInterpolate interpolators[2];
+  static AudioMixer4 mixer;
+  static BenchSink sink;
+  static AudioConnection cord1(oscillators[0], 0, interpolators[0], 0);
+  static AudioConnection cord2(oscillators[1], 0, interpolators[0], 1);
+  static AudioConnection cord3(oscillators[2], 0, interpolators[1], 0);
+  static AudioConnection cord4(oscillators[3], 0, interpolators[1], 1);
+  static AudioConnection cord5(interpolators[0], 0, mixer, 0);
+  static AudioConnection cord6(interpolators[1], 0, mixer, 1);
+  static AudioConnection cord7(mixer, sink);
+  for (int i = 0; i < 4; i++) {
+    oscillators[i].arbitraryWaveform(waveform[i % 2 ? 20 : 10], 800);
+    oscillators[i].begin(0.8, i < 2 ? 218 : 222, WAVEFORM_ARBITRARY);
+  }
+  mixer.gain(0, 0.5);
+  mixer.gain(1, 0.5);
+  return timeBlocks([] {
+    static int n = 0;
+    float factor = 0.5f + 0.4f * sinf(n++ * 0.05f);
+    interpolators[0].setInterpolationFactor(factor);
+    interpolators[1].setInterpolationFactor(factor);
+    for (int i = 0; i < 4; i++) oscillators[i].update();
+    interpolators[0].update();
+    interpolators[1].update();
+    mixer.update();
+    sink.update();
+  });
+}
+
+static double benchWavetableMorph() {
+  benchMemory(16);
+  static AudioSynthWavetableMorph wavetable;
+  static BenchSink sink;
+  static AudioConnection cord(wavetable, sink);
+  wavetable.startWaveform(waveform[10]);
+  wavetable.endWaveform(waveform[20]);
+  wavetable.amplitude(0.8);
+  wavetable.frequency(220, 1.01);
+  return timeBlocks([] {
+    static int n = 0;
+    wavetable.morph(0.5f + 0.4f * sinf(n++ * 0.05f));
+    wavetable.update();
+    sink.update();
+  });
+}
+
+// Sweeping the whole bank, so every block ramps across rows
+static double benchWavetableScan() {
+  benchMemory(16);
+  static AudioSynthWavetableMorph wavetable;
+  static BenchSink sink;
+  static AudioConnection cord(wavetable, sink);
+  static const int16_t *rows[128];
+  for (int i = 0; i < 128; i++) rows[i] = waveform[i];
+  wavetable.scanWaveforms(rows, 128);
+  wavetable.amplitude(0.8);
+  wavetable.frequency(220, 1.01);
+  return timeBlocks([] {
+    static int n = 0;
+    wavetable.position(63.5f + 63.5f * sinf(n++ * 0.05f));
+    wavetable.update();
+    sink.update();
+  });
+}
+
+// A patch change to a table that is not in RAM: all 8 levels unpacked
+static double benchWavetableUnpack() {
+  benchMemory(16);
+  static int16_t memory[WAVETABLE_PACKED_LEVELS * 257];
+  static PackedWavetables flash(waveformPacked[0], 128, WAVETABLE_PACKED_LEVELS);
+  static WavetableCache cache;
+  cache.begin(&flash, memory, sizeof(memory) / sizeof(memory[0]));
+  return timeBlocks([] {
+    static int n = 0;
+    cache.load(n++ & 127);
+  });
+}
+
+// The same from the library file the build writes, read through the mapping
+static double benchWavetableFile() {
+  benchMemory(16);
+  static int16_t memory[WAVETABLE_PACKED_LEVELS * 257];
+  static WavetableFile library;
+  static WavetableCache cache;
+  if (!library.open(WAVETABLE_LIBRARY)) return -1;
+  cache.begin(&library, memory, sizeof(memory) / sizeof(memory[0]));
+  return timeBlocks([] {
+    static int n = 0;
+    cache.load(n++ % library.count());
+  });
+}
+
+static double benchEnvelopeFollower(bool rms) {
+  benchMemory(16);
+  static BenchSource source;
+  static AudioEffectEnvelopeFollower follower;
+  static BenchSink sink;
+  static AudioConnection cord1(source, follower);
+  static AudioConnection cord2(follower, sink);
+  source.begin(220);
+  follower.rms(rms);
+  return timeBlocks([] {
+    source.update();
+    follower.update();
+    sink.update();
+  });
+}
+
+static double benchControlTap(bool history) {
+  benchMemory(16);
+  static BenchSource source;
+  static AudioAnalyzeControlTap tap;
+  static AudioConnection cord(source, tap);
+  static int16_t ring[64];
+  source.begin(220);
+  if (history) tap.history(ring, 64, 4);
+  return timeBlocks([] {
+    source.update();
+    tap.update();
+    // what loop() would do every block, the empty asm keeping the read
+    int16_t mean = tap.read().mean;
+    asm volatile("" : : "r"(mean));
+  });
+}
+
+// A dense MPE stream: sixteen notes on and off against fifteen member
+// channels, so every pass also steals one
+static double benchMPEChannel() {
+  static MPEChannel mpe;
+  return timeBlocks([] {
+    static int base = 0;
+    for (int i = 0; i < 16; i++) mpe.assignChannel((base + i * 7) & 127);
+    for (int i = 0; i < 16; i++) mpe.releaseChannel((base + i * 7) & 127);
+    base++;
+  });
+}
+
+// One voice holding a note, with the voice mixer passing only the given
+// sources. Everything in the voice graph runs through update_all().
+static double benchVoice(float stringGain, float sineGain, float wavetableGain) {
+  benchMemory(64);
+  static AudioSynthKarplusStrongBank<1> strings;
+  static Voice voice;
+  static BenchSink sink;
+  static AudioConnection cord(voice.voiceEnvelope, sink);
+  static int16_t memory[AudioSynthKarplusStronger::MAX_BUFFER_LEN];
+  static DelayLinePool pool;
+  pool.begin(memory, AudioSynthKarplusStronger::MAX_BUFFER_LEN);
+  strings.begin(&pool);
+  voice.connectString(strings, 0);
+  voice.wavetable.startWaveform(waveform[10]);
+  voice.wavetable.endWaveform(waveform[20]);
+  voice.mixGain(STRING, stringGain);
+  voice.mixGain(SINE, sineGain);
+  voice.mixGain(WAVETABLE, wavetableGain);
+  voice.voiceEnvelope.sustain(1.0);
+  voice.noteOn(220, 100);
+  return timeBlocks([] {
+    // replucked like the string cases, so a string voice keeps sounding
+    if (voice.sourcesInUse() & (1 << STRING) && !voice.string.isSounding()) voice.noteOn(220, 100);
+    AudioStream::update_all();
+  });
+}
+
+// A whole synth with a fixed patch and the first `notes` voices playing a
+// note, all of them unless a case says otherwise, built from FullVoice
+// voices unless it says otherwise. If fewer are `held`, the rest are
+// released, and played and released again every 10 seconds, with the
+// strings set to ring for 20 seconds so any left running are timed.
+template<int numVoices, int notes = numVoices, class Policy = FullVoice, int held = notes>
+static double benchSynth() {
+  benchMemory(600);
+  static Synth<numVoices, Policy> *synth = new Synth<numVoices, Policy>;
+  synth->begin();
+  randomSeed(1);
+  synth->createRandomPatch();
+  synth->setAmpSustain(127);
+  synth->blendThreeSourcesNormalized(45);
+  if (held < notes) synth->setStringDecay(127);
+  for (int i = 0; i < notes; i++) {
+    synth->noteOn(36 + i, 100);
+  }
+  if (held == notes) return timeBlocks(AudioStream::update_all);
+  return timeBlocks([] {
+    static int n = 0;
+    if (n-- == 0) {
+      n = 10 * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES;
+      for (int i = held; i < notes; i++) {
+        synth->noteOn(36 + i, 100);
+        synth->noteOff(36 + i);
+      }
+    }
+    AudioStream::update_all();
+  });
+}
+
+struct BenchCase {
+  std::string name;
+  std::function<double()> run;
+  int voices;  // for the voice scaling fit, 0 if not a Synth<N> case
+};
+
+// Runs one case in a child process and reads its result back over a pipe.
+static double runIsolated(const BenchCase &c) {
+  int fds[2];
+  if (pipe(fds) != 0) return -1;
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    double ns = c.run();
+    if (write(fds[1], &ns, sizeof(ns)) != sizeof(ns)) _exit(1);
+    _exit(0);
+  }
+  close(fds[1]);
+  double ns = -1;
+  if (read(fds[0], &ns, sizeof(ns)) != sizeof(ns)) ns = -1;
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  return ns;
+}
+
+int main(int argc, char **argv) {
+  std::string filter;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-n" && i + 1 < argc) {
+      benchBlocks = atoi(argv[++i]);
+    } else if (arg[0] != '-') {
+      filter = arg;
+    } else {
+      fprintf(stderr, "usage: randomsynth_bench [-n blocks] [filter]\n");
+      return 1;
+    }
+  }
+  if (benchBlocks < 10) benchBlocks = 10;
+
+  std::vector<BenchCase> cases = {
+    { "AudioSynthKarplusStronger", benchKarplusStrong, 0 },
+    { "AudioSynthKarplusStronger (glide)", benchKarplusStrongGlide, 0 },
+    { "AudioSynthKarplusStronger (8 note-ons)", benchKarplusStrongChord, 0 },
+    { "AudioSynthKarplusStronger x16", benchKarplusStrongSeparate, 0 },
+    { "AudioSynthKarplusStrongBank<16>", benchKarplusStrongBank, 0 },
+    { "AudioInterpolate (double reference)", benchInterpolateReference, 0 },
+    { "AudioInterpolate", [] { return benchInterpolate(false); }, 0 },
+    { "AudioInterpolate (equal power)", [] { return benchInterpolate(true); }, 0 },
+    { "AudioInterpolate (pass-through)", benchInterpolatePassThrough, 0 },
+    { "Wavetable (oscillators and mixers)", benchWavetableGraph, 0 },
+    { "AudioSynthWavetableMorph", benchWavetableMorph, 0 },
+    { "AudioSynthWavetableMorph (scan)", benchWavetableScan, 0 },
+    { "WavetableCache miss", benchWavetableUnpack, 0 },
+    { "WavetableCache miss (WavetableFile)", benchWavetableFile, 0 },
+    { "AudioEffectEnvelopeFollower", [] { return benchEnvelopeFollower(false); }, 0 },
+    { "AudioEffectEnvelopeFollower (RMS)", [] { return benchEnvelopeFollower(true); }, 0 },
+    { "AudioAnalyzeControlTap", [] { return benchControlTap(false); }, 0 },
+    { "AudioAnalyzeControlTap (history)", [] { return benchControlTap(true); }, 0 },
+    { "MPEChannel (16 note-ons and offs)", benchMPEChannel, 0 },
+    { "Voice (string)", [] { return benchVoice(1, 0, 0); }, 0 },
+    { "Voice (sine)", [] { return benchVoice(0, 1, 0); }, 0 },
+    { "Voice (wavetable)", [] { return benchVoice(0, 0, 1); }, 0 },
+    { "Voice (all sources)", [] { return benchVoice(0.3, 0.3, 0.3); }, 0 },
+    { "Synth<1>", benchSynth<1>, 1 },
+    { "Synth<4>", benchSynth<4>, 4 },
+    { "Synth<8>", benchSynth<8>, 8 },
+    { "Synth<8> (one note)", benchSynth<8, 1>, 0 },
+    { "Synth<8> (one held, seven released)", benchSynth<8, 8, FullVoice, 1>, 0 },
+    { "Synth<8, WavetableVoice>", benchSynth<8, 8, WavetableVoice>, 0 },
+    { "Synth<16>", benchSynth<16>, 16 },
+    { "Synth<32>", benchSynth<32>, 32 },
+    { "Synth<64>", benchSynth<64>, 64 },
+  };
+
+  const double blockNs = 1e9 * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT;
+  printf("%-38s %12s %14s %8s\n", "case", "ns/block", "blocks/sec", "cpu");
+  std::vector<std::pair<double, double>> scaling;
+  bool policies = false;
+  for (const BenchCase &c : cases) {
+    if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+    double ns = runIsolated(c);
+    if (ns <= 0) {
+      printf("%-38s %12s\n", c.name.c_str(), "failed");
+      continue;
+    }
+    printf("%-38s %12.0f %14.0f %7.2f%%\n", c.name.c_str(), ns, 1e9 / ns, 100.0 * ns / blockNs);
+    fflush(stdout);
+    if (c.voices) scaling.emplace_back(c.voices, ns);
+    if (c.name.find("WavetableVoice") != std::string::npos) policies = true;
+  }
+
+  // RAM alongside the time, as leaving nodes out saves both
+  if (policies) {
+    printf("\nsizeof(Synth<8>) %zu bytes, sizeof(Synth<8, WavetableVoice>) %zu bytes\n",
+           sizeof(Synth<8>), sizeof(Synth<8, WavetableVoice>));
+  }
+
+  // Marginal cost of each step up in voice count
+  if (scaling.size() >= 2) {
+    printf("\n");
+    for (size_t i = 1; i < scaling.size(); i++) {
+      double perVoice = (scaling[i].second - scaling[i - 1].second) / (scaling[i].first - scaling[i - 1].first);
+      printf("Synth<%.0f> -> Synth<%.0f>: %.0f ns/block per added voice\n",
+             scaling[i - 1].first, scaling[i].first, perVoice);
+    }
+  }
+  return 0;
+}
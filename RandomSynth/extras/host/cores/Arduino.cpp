@@ -0,0 +1,76 @@
+#include "Arduino.h"
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+volatile uint32_t systick_millis_count = 0;
+
+HostSerial Serial;
+
+uint32_t micros(void) {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void delay(uint32_t msec) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(msec));
+}
+
+// Same Park-Miller generator as the Teensy core, so seeded patches match.
+static uint32_t seed;
+
+void randomSeed(uint32_t newseed) {
+  if (newseed > 0) seed = newseed;
+}
+
+static int32_t random_next(void) {
+  int32_t hi, lo, x;
+
+  x = seed;
+  if (x == 0) x = 123459876;
+  hi = x / 127773;
+  lo = x % 127773;
+  x = 16807 * lo - 2836 * hi;
+  if (x < 0) x += 0x7FFFFFFF;
+  seed = x;
+  return x;
+}
+
+long random(long howbig) {
+  if (howbig == 0) return 0;
+  return (uint32_t)random_next() % (uint32_t)howbig;
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  long diff = howbig - howsmall;
+  return random(diff) + howsmall;
+}
+
+void HostSerial::print(const char *s) {
+  if (enabled) fputs(s, stdout);
+}
+
+void HostSerial::print(char c) {
+  if (enabled) fputc(c, stdout);
+}
+
+void HostSerial::print(int n) {
+  if (enabled) printf("%d", n);
+}
+
+void HostSerial::print(unsigned int n) {
+  if (enabled) printf("%u", n);
+}
+
+void HostSerial::print(long n) {
+  if (enabled) printf("%ld", n);
+}
+
+void HostSerial::print(unsigned long n) {
+  if (enabled) printf("%lu", n);
+}
+
+void HostSerial::print(double n, int digits) {
+  if (enabled) printf("%.*f", digits, n);
+}
@@ -0,0 +1,103 @@
+// Host stand-in for the Teensyduino core.
+// Only the parts of the Arduino API that RandomSynth touches are provided.
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <string>
+#include <type_traits>
+
+#define DMAMEM
+#define FASTRUN
+#define FLASHMEM
+#define PROGMEM
+#define __disable_irq()
+#define __enable_irq()
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#endif
+
+// millis() follows the audio clock rather than the wall clock, so offline
+// renders are reproducible no matter how fast the host runs them.
+extern volatile uint32_t systick_millis_count;
+static inline uint32_t millis(void) { return systick_millis_count; }
+uint32_t micros(void);
+void delay(uint32_t msec);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(uint32_t newseed);
+
+template<class T, class A, class B, class C, class D>
+static inline typename std::enable_if<std::is_integral<T>::value, long>::type
+map(T x, A in_min, B in_max, C out_min, D out_max) {
+  return ((long)x - (long)in_min) * ((long)out_max - (long)out_min) / ((long)in_max - (long)in_min) + (long)out_min;
+}
+
+template<class T, class A, class B, class C, class D>
+static inline typename std::enable_if<std::is_floating_point<T>::value, T>::type
+map(T x, A in_min, B in_max, C out_min, D out_max) {
+  return (x - (T)in_min) * ((T)out_max - (T)out_min) / ((T)in_max - (T)in_min) + (T)out_min;
+}
+
+template<class T, class L, class H>
+static inline T constrain(T amt, L low, H high) {
+  return (amt < (T)low) ? (T)low : ((amt > (T)high) ? (T)high : amt);
+}
+
+template<class A, class B>
+static inline A min(A a, B b) { return (a < (A)b) ? a : (A)b; }
+
+template<class A, class B>
+static inline A max(A a, B b) { return (a > (A)b) ? a : (A)b; }
+
+class String {
+public:
+  String(const char *cstr = "") : str(cstr ? cstr : "") {}
+  String(const std::string &s) : str(s) {}
+  const char *c_str() const { return str.c_str(); }
+  unsigned int length() const { return str.length(); }
+  bool operator==(const String &rhs) const { return str == rhs.str; }
+  bool operator==(const char *rhs) const { return str == rhs; }
+  bool operator!=(const String &rhs) const { return str != rhs.str; }
+  String operator+(const String &rhs) const { return String(str + rhs.str); }
+private:
+  std::string str;
+};
+
+// Serial output is discarded until begin() is called, which keeps offline
+// tools quiet while still letting a ported sketch print as it would on USB.
+class HostSerial {
+public:
+  void begin(uint32_t baud) { enabled = true; }
+  void end() { enabled = false; }
+  int available() { return 0; }
+  int read() { return -1; }
+  operator bool() { return enabled; }
+
+  void print(const char *s);
+  void print(const String &s) { print(s.c_str()); }
+  void print(char c);
+  void print(int n);
+  void print(unsigned int n);
+  void print(long n);
+  void print(unsigned long n);
+  void print(double n, int digits = 2);
+  void println() { print("\n"); }
+  template<class T> void println(const T &v) { print(v); println(); }
+  void println(double n, int digits) { print(n, digits); println(); }
+
+private:
+  bool enabled = false;
+};
+
+extern HostSerial Serial;
+
+#endif
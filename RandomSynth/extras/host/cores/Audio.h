@@ -0,0 +1,20 @@
+// Host stand-in for the Teensy Audio library Audio.h
+//
+// Only the objects RandomSynth and its examples use are provided.
+#ifndef Audio_h_
+#define Audio_h_
+
+#include "control_sgtl5000.h"
+#include "effect_delay.h"
+#include "effect_delay_ext.h"
+#include "effect_envelope.h"
+#include "effect_granular.h"
+#include "filter_ladder.h"
+#include "input_adc.h"
+#include "input_i2s.h"
+#include "mixer.h"
+#include "output_i2s.h"
+#include "synth_dc.h"
+#include "synth_waveform.h"
+
+#endif
@@ -0,0 +1,255 @@
+#include <Arduino.h>
+#include "AudioStream.h"
+
+#define MAX_AUDIO_MEMORY 229376
+
+#define NUM_MASKS  (((MAX_AUDIO_MEMORY / AUDIO_BLOCK_SAMPLES / 2) + 31) / 32)
+
+audio_block_t * AudioStream::memory_pool;
+uint32_t AudioStream::memory_pool_available_mask[NUM_MASKS];
+uint16_t AudioStream::memory_pool_first_mask;
+
+uint16_t AudioStream::cpu_cycles_total = 0;
+uint16_t AudioStream::cpu_cycles_total_max = 0;
+uint16_t AudioStream::memory_used = 0;
+uint16_t AudioStream::memory_used_max = 0;
+AudioStream * AudioStream::first_update = NULL;
+
+// Set up the pool of audio data blocks
+// placing them all onto the free list
+void AudioStream::initialize_memory(audio_block_t *data, unsigned int num)
+{
+  unsigned int i;
+  unsigned int maxnum = MAX_AUDIO_MEMORY / AUDIO_BLOCK_SAMPLES / 2;
+
+  if (num > maxnum) num = maxnum;
+  memory_pool = data;
+  memory_pool_first_mask = 0;
+  for (i=0; i < NUM_MASKS; i++) {
+    memory_pool_available_mask[i] = 0;
+  }
+  for (i=0; i < num; i++) {
+    memory_pool_available_mask[i >> 5] |= (1 << (i & 0x1F));
+  }
+  for (i=0; i < num; i++) {
+    data[i].memory_pool_index = i;
+  }
+}
+
+// Allocate 1 audio data block.  If successful
+// the caller is the only owner of this new block
+audio_block_t * AudioStream::allocate(void)
+{
+  uint32_t n, index, avail;
+  uint32_t *p, *end;
+  audio_block_t *block;
+  uint32_t used;
+
+  p = memory_pool_available_mask;
+  end = p + NUM_MASKS;
+  index = memory_pool_first_mask;
+  p += index;
+  while (1) {
+    if (p >= end) {
+      return NULL;
+    }
+    avail = *p;
+    if (avail) break;
+    index++;
+    p++;
+  }
+  n = __builtin_clz(avail);
+  avail &= ~(0x80000000 >> n);
+  *p = avail;
+  if (!avail) index++;
+  memory_pool_first_mask = index;
+  used = memory_used + 1;
+  memory_used = used;
+  index = p - memory_pool_available_mask;
+  block = memory_pool + ((index << 5) + (31 - n));
+  block->ref_count = 1;
+  if (used > memory_used_max) memory_used_max = used;
+  return block;
+}
+
+// Release ownership of a data block.  If no
+// other streams have ownership, the block is
+// returned to the free pool
+void AudioStream::release(audio_block_t *block)
+{
+  if (block == NULL) return;
+  uint32_t mask = (0x80000000 >> (31 - (block->memory_pool_index & 0x1F)));
+  uint32_t index = block->memory_pool_index >> 5;
+
+  if (block->ref_count > 1) {
+    block->ref_count--;
+  } else {
+    memory_pool_available_mask[index] |= mask;
+    if (index < memory_pool_first_mask) memory_pool_first_mask = index;
+    memory_used--;
+  }
+}
+
+// Transmit an audio data block
+// to all streams that connect to an output.  The block
+// becomes owned by all the recepients, but also is still
+// owned by this object.  Normally, a block must be released
+// by the caller after it's transmitted.  This allows the
+// caller to transmit to same block to more than 1 output,
+// and then release it once after all transmit calls.
+void AudioStream::transmit(audio_block_t *block, unsigned char index)
+{
+  for (AudioConnection *c = destination_list; c != NULL; c = c->next_dest) {
+    if (c->src_index == index) {
+      if (c->dst->inputQueue[c->dest_index] == NULL) {
+        c->dst->inputQueue[c->dest_index] = block;
+        block->ref_count++;
+      }
+    }
+  }
+}
+
+// Receive block from an input.  The block's data
+// may be shared with other streams, so it must not be written
+audio_block_t * AudioStream::receiveReadOnly(unsigned int index)
+{
+  audio_block_t *in;
+
+  if (index >= num_inputs) return NULL;
+  in = inputQueue[index];
+  inputQueue[index] = NULL;
+  return in;
+}
+
+// Receive block from an input.  The block will not
+// be shared, so its contents may be changed.
+audio_block_t * AudioStream::receiveWritable(unsigned int index)
+{
+  audio_block_t *in, *p;
+
+  if (index >= num_inputs) return NULL;
+  in = inputQueue[index];
+  inputQueue[index] = NULL;
+  if (in && in->ref_count > 1) {
+    p = allocate();
+    if (p) memcpy(p->data, in->data, sizeof(p->data));
+    in->ref_count--;
+    in = p;
+  }
+  return in;
+}
+
+AudioConnection::AudioConnection()
+  : src(NULL), dst(NULL), src_index(0), dest_index(0),
+    next_dest(NULL), isConnected(false)
+{
+}
+
+AudioConnection::AudioConnection(AudioStream &source, AudioStream &destination)
+  : AudioConnection()
+{
+  connect(source, 0, destination, 0);
+}
+
+AudioConnection::AudioConnection(AudioStream &source, unsigned char sourceOutput,
+  AudioStream &destination, unsigned char destinationInput)
+  : AudioConnection()
+{
+  connect(source, sourceOutput, destination, destinationInput);
+}
+
+AudioConnection::~AudioConnection()
+{
+  disconnect();
+}
+
+int AudioConnection::connect(AudioStream &source, unsigned char sourceOutput,
+  AudioStream &destination, unsigned char destinationInput)
+{
+  if (isConnected) return 1;
+  src = &source;
+  dst = &destination;
+  src_index = sourceOutput;
+  dest_index = destinationInput;
+  return connect();
+}
+
+int AudioConnection::connect(void)
+{
+  AudioConnection *p;
+
+  if (isConnected) return 0;
+  if (!src || !dst) return 3;
+  if (dest_index >= dst->num_inputs) return 4;
+
+  // Add to the source's destination list
+  p = src->destination_list;
+  if (p == NULL) {
+    src->destination_list = this;
+  } else {
+    while (p->next_dest) p = p->next_dest;
+    p->next_dest = this;
+  }
+  next_dest = NULL;
+  src->numConnections++;
+  src->active = true;
+  dst->numConnections++;
+  dst->active = true;
+  isConnected = true;
+  return 0;
+}
+
+int AudioConnection::disconnect(void)
+{
+  AudioConnection *p;
+
+  if (!isConnected) return 1;
+  if (dest_index >= dst->num_inputs) return 2;
+
+  // Remove destination from source list
+  p = src->destination_list;
+  if (p == NULL) {
+    return 3;
+  } else if (p == this) {
+    src->destination_list = next_dest;
+  } else {
+    while (p) {
+      if (p->next_dest == this) {
+        p->next_dest = this->next_dest;
+        break;
+      }
+      p = p->next_dest;
+    }
+  }
+  // Remove possible pending src block from destination
+  if (dst->inputQueue[dest_index] != NULL) {
+    AudioStream::release(dst->inputQueue[dest_index]);
+    dst->inputQueue[dest_index] = NULL;
+  }
+  // Check if the disconnected AudioStream objects should still be active
+  src->numConnections--;
+  if (src->numConnections == 0) src->active = false;
+  dst->numConnections--;
+  if (dst->numConnections == 0) dst->active = false;
+  isConnected = false;
+  return 0;
+}
+
+// On the Teensy this is the body of software_isr(), run once per block
+// after the I2S DMA interrupt has requested it.
+void AudioStream::update_all(void)
+{
+  static uint32_t samples_to_millis = 0;
+
+  for (AudioStream *p = AudioStream::first_update; p; p = p->next_update) {
+    if (p->active) {
+      p->update();
+    }
+  }
+
+  samples_to_millis += AUDIO_BLOCK_SAMPLES * 1000;
+  while (samples_to_millis >= (uint32_t)AUDIO_SAMPLE_RATE_EXACT) {
+    samples_to_millis -= (uint32_t)AUDIO_SAMPLE_RATE_EXACT;
+    systick_millis_count++;
+  }
+}
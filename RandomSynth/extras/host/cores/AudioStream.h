@@ -0,0 +1,139 @@
+// Host stand-in for the Teensy 4 AudioStream core.
+//
+// Block allocation, reference counting, transmit/receive semantics and the
+// update order (construction order, active objects only) follow the Teensy
+// implementation. The only difference is the clock: instead of the I2S DMA
+// interrupt triggering a software interrupt, the host calls
+// AudioStream::update_all() once per block.
+#ifndef AudioStream_h
+#define AudioStream_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef AUDIO_BLOCK_SAMPLES
+#define AUDIO_BLOCK_SAMPLES  128
+#endif
+
+#ifndef AUDIO_SAMPLE_RATE_EXACT
+#define AUDIO_SAMPLE_RATE_EXACT 44100.0f
+#endif
+
+#define AUDIO_SAMPLE_RATE AUDIO_SAMPLE_RATE_EXACT
+
+#ifndef DMAMEM
+#define DMAMEM
+#endif
+
+#define noAUDIO_DEBUG_CLASS
+
+class AudioStream;
+class AudioConnection;
+
+typedef struct audio_block_struct {
+  uint8_t  ref_count;
+  uint8_t  reserved1;
+  uint16_t memory_pool_index;
+  int16_t  data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioConnection
+{
+public:
+  AudioConnection(AudioStream &source, AudioStream &destination);
+  AudioConnection(AudioStream &source, unsigned char sourceOutput,
+    AudioStream &destination, unsigned char destinationInput);
+  AudioConnection();
+  ~AudioConnection();
+  int disconnect(void);
+  int connect(void);
+  int connect(AudioStream &source, AudioStream &destination) { return connect(source, 0, destination, 0); }
+  int connect(AudioStream &source, unsigned char sourceOutput,
+    AudioStream &destination, unsigned char destinationInput);
+protected:
+  AudioStream *src;
+  AudioStream *dst;
+  unsigned char src_index;
+  unsigned char dest_index;
+  AudioConnection *next_dest;
+  bool isConnected;
+  friend class AudioStream;
+};
+
+#define AudioMemory(num) ({ \
+  static DMAMEM audio_block_t data[num]; \
+  AudioStream::initialize_memory(data, num); \
+})
+
+#define AudioMemoryUsage() (AudioStream::memory_used)
+#define AudioMemoryUsageMax() (AudioStream::memory_used_max)
+#define AudioMemoryUsageMaxReset() (AudioStream::memory_used_max = AudioStream::memory_used)
+
+#define AudioProcessorUsage() (0.0f)
+#define AudioProcessorUsageMax() (0.0f)
+#define AudioProcessorUsageMaxReset() ((void)0)
+
+#define AudioNoInterrupts() ((void)0)
+#define AudioInterrupts() ((void)0)
+
+class AudioStream
+{
+public:
+  AudioStream(unsigned char ninput, audio_block_t **iqueue) :
+    num_inputs(ninput), inputQueue(iqueue) {
+      active = false;
+      destination_list = NULL;
+      for (int i=0; i < num_inputs; i++) {
+        inputQueue[i] = NULL;
+      }
+      // add to a simple list, for update_all
+      if (first_update == NULL) {
+        first_update = this;
+      } else {
+        AudioStream *p;
+        for (p=first_update; p->next_update; p = p->next_update) ;
+        p->next_update = this;
+      }
+      next_update = NULL;
+      cpu_cycles = 0;
+      cpu_cycles_max = 0;
+      numConnections = 0;
+    }
+  static void initialize_memory(audio_block_t *data, unsigned int num);
+  float processorUsage(void) { return 0.0f; }
+  float processorUsageMax(void) { return 0.0f; }
+  void processorUsageMaxReset(void) { cpu_cycles_max = cpu_cycles; }
+  bool isActive(void) { return active; }
+  uint16_t cpu_cycles;
+  uint16_t cpu_cycles_max;
+  static uint16_t cpu_cycles_total;
+  static uint16_t cpu_cycles_total_max;
+  static uint16_t memory_used;
+  static uint16_t memory_used_max;
+  // Runs one audio block through every active object, in construction
+  // order, and advances millis() by one block.
+  static void update_all(void);
+protected:
+  bool active;
+  unsigned char num_inputs;
+  static audio_block_t * allocate(void);
+  static void release(audio_block_t * block);
+  void transmit(audio_block_t *block, unsigned char index = 0);
+  audio_block_t * receiveReadOnly(unsigned int index = 0);
+  audio_block_t * receiveWritable(unsigned int index = 0);
+  static bool update_setup(void) { return true; }
+  static void update_stop(void) {}
+  friend class AudioConnection;
+  uint8_t numConnections;
+private:
+  AudioConnection *destination_list;
+  audio_block_t **inputQueue;
+  virtual void update(void) = 0;
+  static AudioStream *first_update; // for update_all
+  AudioStream *next_update; // for update_all
+  static audio_block_t *memory_pool;
+  static uint32_t memory_pool_available_mask[];
+  static uint16_t memory_pool_first_mask;
+};
+
+#endif
@@ -0,0 +1,14 @@
+// Host stand-in for CMSIS arm_math.h: just the fixed-point types.
+#ifndef _ARM_MATH_H
+#define _ARM_MATH_H
+
+#include <stdint.h>
+
+typedef int8_t q7_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+typedef float float32_t;
+typedef double float64_t;
+
+#endif
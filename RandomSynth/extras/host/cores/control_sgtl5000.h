@@ -0,0 +1,21 @@
+// Host stand-in for the Teensy Audio library control_sgtl5000.h
+#ifndef control_sgtl5000_h_
+#define control_sgtl5000_h_
+
+#include <Arduino.h>
+
+class AudioControlSGTL5000
+{
+public:
+  bool enable(void) { return true; }
+  bool disable(void) { return false; }
+  bool volume(float n) { return true; }
+  bool inputSelect(int n) { return true; }
+  bool lineOutLevel(uint8_t n) { return true; }
+  bool micGain(unsigned int dB) { return true; }
+};
+
+#define AUDIO_INPUT_LINEIN  0
+#define AUDIO_INPUT_MIC     1
+
+#endif
@@ -0,0 +1,75 @@
+// Host stand-in for the Teensy Audio library effect_delay.h
+#ifndef effect_delay_h_
+#define effect_delay_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+// Same capacity as the Teensy 4 build: 4.00 second maximum
+#define DELAY_QUEUE_SIZE  (176512 / AUDIO_BLOCK_SAMPLES)
+
+class AudioEffectDelay : public AudioStream
+{
+public:
+  AudioEffectDelay() : AudioStream(1, inputQueueArray) {
+    activemask = 0;
+    headindex = 0;
+    tailindex = 0;
+    maxblocks = 0;
+    memset(queue, 0, sizeof(queue));
+  }
+  void delay(uint8_t channel, float milliseconds) {
+    if (channel >= 8) return;
+    if (milliseconds < 0.0f) milliseconds = 0.0f;
+    uint32_t n = (milliseconds*(AUDIO_SAMPLE_RATE_EXACT/1000.0f))+0.5f;
+    uint32_t nmax = AUDIO_BLOCK_SAMPLES * (DELAY_QUEUE_SIZE-1);
+    if (n > nmax) n = nmax;
+    uint32_t blks = (n + (AUDIO_BLOCK_SAMPLES-1)) / AUDIO_BLOCK_SAMPLES + 1;
+    if (!(activemask & (1<<channel))) {
+      // enabling a previously disabled channel
+      delay_samples[channel] = n;
+      if (blks > maxblocks) maxblocks = blks;
+      activemask |= (1<<channel);
+    } else {
+      if (n > delay_samples[channel]) {
+        // new delay is greater than previous setting
+        if (blks > maxblocks) maxblocks = blks;
+        delay_samples[channel] = n;
+      } else {
+        // new delay is less than previous setting
+        delay_samples[channel] = n;
+        recompute_maxblocks();
+      }
+    }
+  }
+  void disable(uint8_t channel) {
+    if (channel >= 8) return;
+    // diable this channel
+    activemask &= ~(1<<channel);
+    // recompute maxblocks for remaining enabled channels
+    recompute_maxblocks();
+  }
+  virtual void update(void);
+private:
+  void recompute_maxblocks(void) {
+    uint32_t max=0;
+    uint32_t channel = 0;
+    do {
+      if (activemask & (1<<channel)) {
+        uint32_t n = delay_samples[channel];
+        n = (n + (AUDIO_BLOCK_SAMPLES-1)) / AUDIO_BLOCK_SAMPLES + 1;
+        if (n > max) max = n;
+      }
+    } while(++channel < 8);
+    maxblocks = max;
+  }
+  uint8_t activemask;   // which output channels are active
+  uint16_t headindex;    // head index (incoming) data in quueu
+  uint16_t tailindex;    // tail index (outgoing) data from queue
+  uint16_t maxblocks;    // number of blocks needed in queue
+  uint32_t delay_samples[8];   // # of samples delay for each channel
+  audio_block_t *queue[DELAY_QUEUE_SIZE];
+  audio_block_t *inputQueueArray[1];
+};
+
+#endif
@@ -0,0 +1,10 @@
+// Host stand-in for the Teensy Audio library effect_delay_ext.h
+//
+// External SPI RAM is not emulated; RandomSynth only includes this header.
+#ifndef effect_delay_ext_h_
+#define effect_delay_ext_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+#endif
@@ -0,0 +1,50 @@
+// Host stand-in for the Teensy Audio library effect_granular.h
+#ifndef effect_granular_h_
+#define effect_granular_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+class AudioEffectGranular : public AudioStream
+{
+public:
+  AudioEffectGranular(void): AudioStream(1,inputQueueArray) {
+    sample_bank = NULL;
+  }
+  void begin(int16_t *sample_bank_def, int16_t max_len_def);
+  void setSpeed(float ratio) {
+    if (ratio < 0.125f) ratio = 0.125f;
+    else if (ratio > 8.0f) ratio = 8.0f;
+    playpack_rate = ratio * 65536.0f + 0.499f;
+  }
+  void beginFreeze(float grain_length) {
+    if (grain_length <= 0.0f) return;
+    beginFreeze_int(grain_length * (AUDIO_SAMPLE_RATE_EXACT * 0.001f) + 0.5f);
+  }
+  void beginPitchShift(float grain_length) {
+    if (grain_length <= 0.0f) return;
+    beginPitchShift_int(grain_length * (AUDIO_SAMPLE_RATE_EXACT * 0.001f) + 0.5f);
+  }
+  void stop();
+  virtual void update(void);
+private:
+  void beginFreeze_int(int grain_samples);
+  void beginPitchShift_int(int grain_samples);
+  audio_block_t *inputQueueArray[1];
+  int16_t *sample_bank;
+  uint32_t playpack_rate;
+  uint32_t accumulator;
+  int16_t max_sample_len;
+  int16_t write_head;
+  int16_t read_head;
+  int16_t grain_mode;
+  int16_t freeze_len;
+  int16_t prev_input;
+  int16_t glitch_len;
+  bool allow_len_change;
+  bool sample_loaded;
+  bool write_en;
+  bool sample_req;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include <Arduino.h>
+#include "filter_ladder.h"
+
+#define MOOG_PI ((float)3.14159265358979323846264338327950288)
+#define INTERPOLATION 2
+#define MAX_RESONANCE ((float)1.8)
+#define MAX_FREQUENCY ((float)(AUDIO_SAMPLE_RATE_EXACT * 0.425f))
+
+static inline float fast_exp2(const float x)
+{
+  return exp2f(x);
+}
+
+static inline float fast_tanh(float x)
+{
+  if (x > 3.0f) return 1.0f;
+  if (x < -3.0f) return -1.0f;
+  float x2 = x * x;
+  return x * (27.0f + x2) / (27.0f + 9.0f * x2);
+}
+
+float AudioFilterLadder::LPF(float s, int i)
+{
+  float ft = s * (1.0f/1.3f) + (0.3f/1.3f) * z0[i] - z1[i];
+  ft = ft * alpha + z1[i];
+  z1[i] = ft;
+  z0[i] = s;
+  return ft;
+}
+
+void AudioFilterLadder::resonance(float res)
+{
+  // maps resonance = 0->1 to K = 0 -> 4
+  if (res > MAX_RESONANCE) {
+    res = MAX_RESONANCE;
+  } else if (res < 0.0f) {
+    res = 0.0f;
+  }
+  K = 4.0f * res;
+}
+
+void AudioFilterLadder::frequency(float c)
+{
+  Fbase = c;
+  compute_coeffs(c);
+}
+
+void AudioFilterLadder::compute_coeffs(float c)
+{
+  if (c > MAX_FREQUENCY) {
+    c = MAX_FREQUENCY;
+  } else if (c < 5.0f) {
+    c = 5.0f;
+  }
+  float wc = c * (float)(2.0f * MOOG_PI / ((float)INTERPOLATION * AUDIO_SAMPLE_RATE_EXACT));
+  float wc2 = wc * wc;
+  alpha = 0.9892f * wc - 0.4324f * wc2 + 0.1381f * wc * wc2 - 0.0202f * wc2 * wc2;
+  Qadjust = 1.0029f + 0.0526f * wc - 0.0926f * wc2 + 0.0218f * wc * wc2;
+}
+
+void AudioFilterLadder::octaveControl(float octaves)
+{
+  if (octaves > 7.0f) {
+    octaves = 7.0f;
+  } else if (octaves < 0.0f) {
+    octaves = 0.0f;
+  }
+  octaveScale = octaves / 32768.0f;
+}
+
+void AudioFilterLadder::passbandGain(float passbandgain)
+{
+  pbg = passbandgain;
+  if (pbg > 0.5f) pbg = 0.5f;
+  if (pbg < 0.0f) pbg = 0.0f;
+  inputDrive(host_overdrive);
+}
+
+void AudioFilterLadder::inputDrive(float odrv)
+{
+  host_overdrive = odrv;
+  if (host_overdrive > 1.0f) {
+    if (host_overdrive > 4.0f) host_overdrive = 4.0f;
+    overdrive = 1.0f + (host_overdrive - 1.0f) * (1.0f - pbg);
+  } else {
+    overdrive = host_overdrive;
+    if (overdrive < 0.0f) overdrive = 0.0f;
+  }
+}
+
+bool AudioFilterLadder::resonating()
+{
+  for (int i=0; i < 4; i++) {
+    if (fabsf(z0[i]) > 0.0001f) return true;
+    if (fabsf(z1[i]) > 0.0001f) return true;
+  }
+  return false;
+}
+
+void AudioFilterLadder::update(void)
+{
+  audio_block_t *blocka, *blockb, *blockc;
+  float Ktot = K;
+  bool FCmodActive = true;
+
+  blocka = receiveWritable(0);
+  blockb = receiveReadOnly(1);
+  blockc = receiveReadOnly(2);
+  if (!blockb) FCmodActive = false;
+  if (!blocka) {
+    // let the resonance ring out on silent input
+    if (resonating() && (blocka = allocate()) != NULL) {
+      memset(blocka->data, 0, sizeof(blocka->data));
+    } else {
+      if (blockb) release(blockb);
+      if (blockc) release(blockc);
+      return;
+    }
+  }
+  for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    float input = blocka->data[i] * (1.0f/32768.0f) * overdrive;
+    if (FCmodActive) {
+      float FCmod = blockb->data[i] * octaveScale;
+      float ftot = Fbase * fast_exp2(FCmod);
+      compute_coeffs(ftot);
+    }
+    if (blockc) {
+      Ktot = K + 4.0f * blockc->data[i] * (1.0f/32768.0f);
+      if (Ktot > 4.0f * MAX_RESONANCE) {
+        Ktot = 4.0f * MAX_RESONANCE;
+      } else if (Ktot < 0.0f) {
+        Ktot = 0.0f;
+      }
+    }
+    float stage4 = 0.0f;
+    for (int os=0; os < INTERPOLATION; os++) {
+      float inx = prev_input + (input - prev_input) * (float)(os + 1) / (float)INTERPOLATION;
+      float u = inx - (z1[3] - pbg * inx) * Ktot * Qadjust;
+      u = fast_tanh(u);
+      float stage1 = LPF(u, 0);
+      float stage2 = LPF(stage1, 1);
+      float stage3 = LPF(stage2, 2);
+      stage4 = LPF(stage3, 3);
+    }
+    prev_input = input;
+    float out = stage4 * 32767.0f;
+    if (out > 32767.0f) out = 32767.0f;
+    else if (out < -32768.0f) out = -32768.0f;
+    blocka->data[i] = out;
+  }
+  transmit(blocka);
+  release(blocka);
+  if (blockb) release(blockb);
+  if (blockc) release(blockc);
+}
@@ -0,0 +1,52 @@
+// Host stand-in for the Teensy Audio library filter_ladder.h
+//
+// Huovilainen-style four pole ladder with a tanh input stage, running at 2x
+// oversampling like the Teensy version. Input 1 modulates the corner
+// frequency in octaves, input 2 modulates resonance.
+#ifndef filter_ladder_h_
+#define filter_ladder_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+class AudioFilterLadder: public AudioStream
+{
+public:
+  AudioFilterLadder() : AudioStream(3, inputQueueArray) {
+    for (int i=0; i < 4; i++) {
+      z0[i] = 0;
+      z1[i] = 0;
+    }
+    prev_input = 0;
+    pbg = 0;
+    host_overdrive = 1.0f;
+    frequency(1000.0f);
+    resonance(0.0f);
+    octaveControl(1.0f);
+    inputDrive(1.0f);
+  }
+  void frequency(float FC);
+  void resonance(float reson);
+  void octaveControl(float octaves);
+  void passbandGain(float passbandgain);
+  void inputDrive(float drive);
+  virtual void update(void);
+private:
+  float LPF(float s, int i);
+  void compute_coeffs(float fc);
+  bool resonating();
+  audio_block_t *inputQueueArray[3];
+  float z0[4];
+  float z1[4];
+  float prev_input;
+  float K;
+  float Fbase;
+  float alpha;
+  float Qadjust;
+  float octaveScale;
+  float pbg;
+  float overdrive;
+  float host_overdrive;
+};
+
+#endif
@@ -0,0 +1,16 @@
+// Host stand-in for the Teensy Audio library input_adc.h
+#ifndef input_adc_h_
+#define input_adc_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+class AudioInputAnalog : public AudioStream
+{
+public:
+  AudioInputAnalog() : AudioStream(0, NULL) {}
+  AudioInputAnalog(uint8_t pin) : AudioStream(0, NULL) {}
+  virtual void update(void) {}
+};
+
+#endif
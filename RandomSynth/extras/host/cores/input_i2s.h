@@ -0,0 +1,19 @@
+// Host stand-in for the Teensy Audio library input_i2s.h
+//
+// There is no codec on the host, so the input transmits nothing, which the
+// audio library treats as silence.
+#ifndef _input_i2s_h_
+#define _input_i2s_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+class AudioInputI2S : public AudioStream
+{
+public:
+  AudioInputI2S(void) : AudioStream(0, NULL) { begin(); }
+  virtual void update(void) {}
+  void begin(void) {}
+};
+
+#endif
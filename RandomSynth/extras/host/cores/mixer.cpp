@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include "mixer.h"
+#include "utility/dspinst.h"
+
+#define MULTI_UNITYGAIN 65536
+
+static void applyGain(int16_t *data, int32_t mult)
+{
+  const int16_t *end = data + AUDIO_BLOCK_SAMPLES;
+
+  do {
+    int64_t val = ((int64_t)*data * mult) >> 16;
+    if (val > 32767) val = 32767;
+    else if (val < -32768) val = -32768;
+    *data++ = val;
+  } while (data < end);
+}
+
+static void applyGainThenAdd(int16_t *dst, const int16_t *src, int32_t mult)
+{
+  const int16_t *end = dst + AUDIO_BLOCK_SAMPLES;
+
+  if (mult == MULTI_UNITYGAIN) {
+    do {
+      int32_t val = *dst + *src++;
+      *dst++ = signed_saturate_rshift(val, 16, 0);
+    } while (dst < end);
+  } else {
+    do {
+      int64_t val = *dst + (((int64_t)*src++ * mult) >> 16);
+      if (val > 32767) val = 32767;
+      else if (val < -32768) val = -32768;
+      *dst++ = val;
+    } while (dst < end);
+  }
+}
+
+void AudioMixer4::update(void)
+{
+  audio_block_t *in, *out=NULL;
+  unsigned int channel;
+
+  for (channel=0; channel < 4; channel++) {
+    if (!out) {
+      out = receiveWritable(channel);
+      if (out) {
+        int32_t mult = multiplier[channel];
+        if (mult != MULTI_UNITYGAIN) applyGain(out->data, mult);
+      }
+    } else {
+      in = receiveReadOnly(channel);
+      if (in) {
+        applyGainThenAdd(out->data, in->data, multiplier[channel]);
+        release(in);
+      }
+    }
+  }
+  if (out) {
+    transmit(out);
+    release(out);
+  }
+}
+
+void AudioAmplifier::update(void)
+{
+  audio_block_t *block;
+  int32_t mult = multiplier;
+
+  if (mult == 0) {
+    // zero gain, discard any input and transmit nothing
+    block = receiveReadOnly(0);
+    if (block) release(block);
+  } else if (mult == MULTI_UNITYGAIN) {
+    // unity gain, pass input to output without any change
+    block = receiveReadOnly(0);
+    if (block) {
+      transmit(block);
+      release(block);
+    }
+  } else {
+    // apply gain to signal
+    block = receiveWritable(0);
+    if (block) {
+      applyGain(block->data, mult);
+      transmit(block);
+      release(block);
+    }
+  }
+}
@@ -0,0 +1,42 @@
+// Host stand-in for the Teensy Audio library mixer.h
+#ifndef mixer_h_
+#define mixer_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+class AudioMixer4 : public AudioStream
+{
+public:
+  AudioMixer4(void) : AudioStream(4, inputQueueArray) {
+    for (int i=0; i<4; i++) multiplier[i] = 65536;
+  }
+  virtual void update(void);
+  void gain(unsigned int channel, float gain) {
+    if (channel >= 4) return;
+    if (gain > 32767.0f) gain = 32767.0f;
+    else if (gain < -32767.0f) gain = -32767.0f;
+    multiplier[channel] = gain * 65536.0f; // TODO: proper roundoff?
+  }
+private:
+  int32_t multiplier[4];
+  audio_block_t *inputQueueArray[4];
+};
+
+class AudioAmplifier : public AudioStream
+{
+public:
+  AudioAmplifier(void) : AudioStream(1, inputQueueArray), multiplier(65536) {
+  }
+  virtual void update(void);
+  void gain(float n) {
+    if (n > 32767.0f) n = 32767.0f;
+    else if (n < -32767.0f) n = -32767.0f;
+    multiplier = n * 65536.0f;
+  }
+private:
+  int32_t multiplier;
+  audio_block_t *inputQueueArray[1];
+};
+
+#endif
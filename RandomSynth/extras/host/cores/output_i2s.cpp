@@ -0,0 +1,37 @@
+#include <Arduino.h>
+#include "output_i2s.h"
+
+int16_t AudioOutputI2S::last_left[AUDIO_BLOCK_SAMPLES];
+int16_t AudioOutputI2S::last_right[AUDIO_BLOCK_SAMPLES];
+
+void AudioOutputI2S::begin(void)
+{
+  memset(last_left, 0, sizeof(last_left));
+  memset(last_right, 0, sizeof(last_right));
+}
+
+void AudioOutputI2S::update(void)
+{
+  audio_block_t *block;
+
+  block = receiveReadOnly(0); // input 0 = left channel
+  if (block) {
+    memcpy(last_left, block->data, sizeof(last_left));
+    release(block);
+  } else {
+    memset(last_left, 0, sizeof(last_left));
+  }
+  block = receiveReadOnly(1); // input 1 = right channel
+  if (block) {
+    memcpy(last_right, block->data, sizeof(last_right));
+    release(block);
+  } else {
+    memset(last_right, 0, sizeof(last_right));
+  }
+}
+
+void AudioOutputI2S::readBlock(int16_t *left, int16_t *right)
+{
+  if (left) memcpy(left, last_left, sizeof(last_left));
+  if (right) memcpy(right, last_right, sizeof(last_right));
+}
@@ -0,0 +1,27 @@
+// Host stand-in for the Teensy Audio library output_i2s.h
+//
+// Instead of feeding the DMA buffers, update() keeps the most recent left
+// and right blocks so a host driver can collect them after each
+// AudioStream::update_all().
+#ifndef output_i2s_h_
+#define output_i2s_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+class AudioOutputI2S : public AudioStream
+{
+public:
+  AudioOutputI2S(void) : AudioStream(2, inputQueueArray) { begin(); }
+  virtual void update(void);
+  void begin(void);
+  // Copies the last rendered block of each channel; silence if the channel
+  // received nothing.
+  static void readBlock(int16_t *left, int16_t *right);
+private:
+  static int16_t last_left[AUDIO_BLOCK_SAMPLES];
+  static int16_t last_right[AUDIO_BLOCK_SAMPLES];
+  audio_block_t *inputQueueArray[2];
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include "synth_dc.h"
+
+void AudioSynthWaveformDc::update(void)
+{
+  audio_block_t *block;
+  int16_t *p, *end;
+  int32_t count, t1, t2, t3, t4;
+
+  block = allocate();
+  if (!block) return;
+  p = block->data;
+  end = p + AUDIO_BLOCK_SAMPLES;
+  if (state == 0) {
+    // steady DC output, simply fill the buffer with fixed value
+    int16_t val = magnitude >> 16;
+    do {
+      *p++ = val;
+    } while (p < end);
+  } else {
+    // transitioning to a new DC level
+    count = (target - magnitude) / increment;
+    if (count >= AUDIO_BLOCK_SAMPLES) {
+      // this update will not reach the target
+      do {
+        magnitude += increment;
+        t1 = magnitude >> 16;
+        magnitude += increment;
+        t2 = magnitude >> 16;
+        magnitude += increment;
+        t3 = magnitude >> 16;
+        magnitude += increment;
+        t4 = magnitude >> 16;
+        *p++ = t1;
+        *p++ = t2;
+        *p++ = t3;
+        *p++ = t4;
+      } while (p < end);
+    } else {
+      // this update reaches the target
+      while (count >= 2) {
+        count -= 2;
+        magnitude += increment;
+        *p++ = magnitude >> 16;
+        magnitude += increment;
+        *p++ = magnitude >> 16;
+      }
+      if (count) {
+        magnitude += increment;
+        *p++ = magnitude >> 16;
+      }
+      magnitude = target;
+      state = 0;
+      int16_t val = magnitude >> 16;
+      while (p < end) {
+        *p++ = val;
+      }
+    }
+  }
+  transmit(block);
+  release(block);
+}
@@ -0,0 +1,67 @@
+// Host stand-in for the Teensy Audio library synth_dc.h
+#ifndef synth_dc_h_
+#define synth_dc_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+#include "utility/dspinst.h"
+
+// compute (a - b) / c
+// handling 32 bit interger overflow at every step
+// without resorting to slow 64 bit math
+static inline int32_t substract_int32_then_divide_int32(int32_t a, int32_t b, int32_t c) __attribute__((always_inline, unused));
+static inline int32_t substract_int32_then_divide_int32(int32_t a, int32_t b, int32_t c)
+{
+  return ((int64_t)a - (int64_t)b) / c;
+}
+
+class AudioSynthWaveformDc : public AudioStream
+{
+public:
+  AudioSynthWaveformDc() : AudioStream(0, NULL), state(0), magnitude(0) {}
+  // immediately jump to the new DC level
+  void amplitude(float n) {
+    if (n > 1.0f) n = 1.0f;
+    else if (n < -1.0f) n = -1.0f;
+    int32_t m = (int32_t)(n * 2147418112.0f);
+    magnitude = m;
+    state = 0;
+  }
+  // slowly transition to the new DC level
+  void amplitude(float n, float milliseconds) {
+    if (milliseconds <= 0.0f) {
+      amplitude(n);
+      return;
+    }
+    if (n > 1.0f) n = 1.0f;
+    else if (n < -1.0f) n = -1.0f;
+    int32_t c = (int32_t)(milliseconds*(AUDIO_SAMPLE_RATE_EXACT/1000.0f));
+    if (c == 0) {
+      amplitude(n);
+      return;
+    }
+    int32_t t = (int32_t)(n * 2147418112.0f);
+    target = t;
+    if (target == magnitude) {
+      state = 0;
+      return;
+    }
+    increment = substract_int32_then_divide_int32(target, magnitude, c);
+    if (increment == 0) {
+      increment = (target > magnitude) ? 1 : -1;
+    }
+    state = 1;
+  }
+  float read(void) {
+    int32_t m = magnitude;
+    return (float)m * (1.0f / 2147418112.0f);
+  }
+  virtual void update(void);
+private:
+  uint8_t  state;     // 0=steady output, 1=transitioning
+  int32_t  magnitude; // current output
+  int32_t  target;    // designed output (while transitiong)
+  int32_t  increment; // adjustment per sample (while transitiong)
+};
+
+#endif
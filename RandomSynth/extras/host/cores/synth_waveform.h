@@ -0,0 +1,189 @@
+// Host stand-in for the Teensy Audio library synth_waveform.h
+//
+// The band-limited waveform types are rendered with their naive
+// counterparts; everything RandomSynth uses (sine, triangle, arbitrary)
+// follows the Teensy phase accumulator and interpolation exactly.
+#ifndef synth_waveform_h_
+#define synth_waveform_h_
+
+#include <Arduino.h>
+#include "AudioStream.h"
+
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+}
+
+#define WAVEFORM_SINE              0
+#define WAVEFORM_SAWTOOTH          1
+#define WAVEFORM_SQUARE            2
+#define WAVEFORM_TRIANGLE          3
+#define WAVEFORM_ARBITRARY         4
+#define WAVEFORM_PULSE             5
+#define WAVEFORM_SAWTOOTH_REVERSE  6
+#define WAVEFORM_SAMPLE_HOLD       7
+#define WAVEFORM_TRIANGLE_VARIABLE 8
+#define WAVEFORM_BANDLIMIT_SAWTOOTH  9
+#define WAVEFORM_BANDLIMIT_SAWTOOTH_REVERSE 10
+#define WAVEFORM_BANDLIMIT_SQUARE 11
+#define WAVEFORM_BANDLIMIT_PULSE  12
+
+class AudioSynthWaveform : public AudioStream
+{
+public:
+  AudioSynthWaveform(void) : AudioStream(0,NULL),
+    phase_accumulator(0), phase_increment(0), phase_offset(0),
+    magnitude(0), pulse_width(0x40000000),
+    arbdata(NULL), sample(0), tone_type(WAVEFORM_SINE),
+    tone_offset(0) {
+  }
+
+  void frequency(float freq) {
+    if (freq < 0.0f) {
+      freq = 0.0;
+    } else if (freq > AUDIO_SAMPLE_RATE_EXACT / 2.0f) {
+      freq = AUDIO_SAMPLE_RATE_EXACT / 2.0f;
+    }
+    phase_increment = freq * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+    if (phase_increment > 0x7FFE0000u) phase_increment = 0x7FFE0000;
+  }
+  void phase(float angle) {
+    if (angle < 0.0f) {
+      angle = 0.0;
+    } else if (angle > 360.0f) {
+      angle = angle - 360.0f;
+      if (angle >= 360.0f) return;
+    }
+    phase_offset = angle * (float)(4294967296.0 / 360.0);
+  }
+  void amplitude(float n) {  // 0 to 1.0
+    if (n < 0) {
+      n = 0;
+    } else if (n > 1.0f) {
+      n = 1.0f;
+    }
+    magnitude = n * 65536.0f;
+  }
+  void offset(float n) {
+    if (n < -1.0f) {
+      n = -1.0f;
+    } else if (n > 1.0f) {
+      n = 1.0f;
+    }
+    tone_offset = n * 32767.0f;
+  }
+  void pulseWidth(float n) {  // 0.0 to 1.0
+    if (n < 0) {
+      n = 0;
+    } else if (n > 1.0f) {
+      n = 1.0f;
+    }
+    pulse_width = n * 4294967296.0f;
+  }
+  void begin(short t_type) {
+    phase_offset = 0;
+    tone_type = t_type;
+  }
+  void begin(float t_amp, float t_freq, short t_type) {
+    amplitude(t_amp);
+    frequency(t_freq);
+    phase_offset = 0;
+    begin(t_type);
+  }
+  void arbitraryWaveform(const int16_t *data, float maxFreq) {
+    arbdata = data;
+  }
+  virtual void update(void);
+
+private:
+  uint32_t phase_accumulator;
+  uint32_t phase_increment;
+  uint32_t phase_offset;
+  int32_t  magnitude;
+  uint32_t pulse_width;
+  const int16_t *arbdata;
+  int16_t  sample; // for WAVEFORM_SAMPLE_HOLD
+  short    tone_type;
+  int16_t  tone_offset;
+};
+
+
+class AudioSynthWaveformModulated : public AudioStream
+{
+public:
+  AudioSynthWaveformModulated(void) : AudioStream(2, inputQueueArray),
+    phase_accumulator(0), phase_increment(0), modulation_factor(32768),
+    magnitude(0), arbdata(NULL), sample(0), tone_offset(0),
+    tone_type(WAVEFORM_SINE), modulation_type(0) {
+  }
+
+  void frequency(float freq) {
+    if (freq < 0.0f) {
+      freq = 0.0;
+    } else if (freq > AUDIO_SAMPLE_RATE_EXACT / 2.0f) {
+      freq = AUDIO_SAMPLE_RATE_EXACT / 2.0f;
+    }
+    phase_increment = freq * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+    if (phase_increment > 0x7FFE0000u) phase_increment = 0x7FFE0000;
+  }
+  void amplitude(float n) {  // 0 to 1.0
+    if (n < 0) {
+      n = 0;
+    } else if (n > 1.0f) {
+      n = 1.0f;
+    }
+    magnitude = n * 65536.0f;
+  }
+  void offset(float n) {
+    if (n < -1.0f) {
+      n = -1.0f;
+    } else if (n > 1.0f) {
+      n = 1.0f;
+    }
+    tone_offset = n * 32767.0f;
+  }
+  void begin(short t_type) {
+    tone_type = t_type;
+  }
+  void begin(float t_amp, float t_freq, short t_type) {
+    amplitude(t_amp);
+    frequency(t_freq);
+    begin(t_type);
+  }
+  void arbitraryWaveform(const int16_t *data, float maxFreq) {
+    arbdata = data;
+  }
+  void frequencyModulation(float octaves) {
+    if (octaves > 12.0f) {
+      octaves = 12.0f;
+    } else if (octaves < 0.1f) {
+      octaves = 0.1f;
+    }
+    modulation_factor = octaves * 4096.0f;
+    modulation_type = 0;
+  }
+  void phaseModulation(float degrees) {
+    if (degrees > 9000.0f) {
+      degrees = 9000.0f;
+    } else if (degrees < 30.0f) {
+      degrees = 30.0f;
+    }
+    modulation_factor = degrees * (float)(65536.0 / 180.0);
+    modulation_type = 1;
+  }
+  virtual void update(void);
+
+private:
+  audio_block_t *inputQueueArray[2];
+  uint32_t phase_accumulator;
+  uint32_t phase_increment;
+  uint32_t modulation_factor;
+  int32_t  magnitude;
+  const int16_t *arbdata;
+  uint32_t phasedata[AUDIO_BLOCK_SAMPLES];
+  int16_t  sample; // for WAVEFORM_SAMPLE_HOLD
+  int16_t  tone_offset;
+  uint8_t  tone_type;
+  uint8_t  modulation_type;
+};
+
+#endif
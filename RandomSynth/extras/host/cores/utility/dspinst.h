@@ -0,0 +1,179 @@
+// Portable C versions of the Cortex-M4/M7 DSP helpers from the Teensy Audio
+// library. Results match the ARM instructions bit for bit.
+#ifndef dspinst_h_
+#define dspinst_h_
+
+#include <stdint.h>
+
+// computes limit((val >> rshift), 2**bits)
+static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift) __attribute__((always_inline, unused));
+static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift)
+{
+  int32_t out, max;
+  out = val >> rshift;
+  max = 1 << (bits - 1);
+  if (out >= 0) {
+    if (out > max - 1) out = max - 1;
+  } else {
+    if (out < -max) out = -max;
+  }
+  return out;
+}
+
+// computes limit(val, 2**bits)
+static inline int16_t saturate16(int32_t val) __attribute__((always_inline, unused));
+static inline int16_t saturate16(int32_t val)
+{
+  if (val > 32767) val = 32767;
+  else if (val < -32768) val = -32768;
+  return val;
+}
+
+// computes ((a[31:0] * b[15:0]) >> 16)
+static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b)
+{
+  return ((int64_t)a * (int16_t)(b & 0xFFFF)) >> 16;
+}
+
+// computes ((a[31:0] * b[31:16]) >> 16)
+static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b)
+{
+  return ((int64_t)a * (int16_t)(b >> 16)) >> 16;
+}
+
+// computes (((int64_t)a[31:0] * (int64_t)b[31:0]) >> 32)
+static inline int32_t multiply_32x32_rshift32(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_32x32_rshift32(int32_t a, int32_t b)
+{
+  return ((int64_t)a * (int64_t)b) >> 32;
+}
+
+// computes (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x80000000) >> 32)
+static inline int32_t multiply_32x32_rshift32_rounded(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_32x32_rshift32_rounded(int32_t a, int32_t b)
+{
+  return (((int64_t)a * (int64_t)b) + 0x80000000) >> 32;
+}
+
+// computes sum + (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x80000000) >> 32)
+static inline int32_t multiply_accumulate_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_accumulate_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b)
+{
+  return sum + ((((int64_t)a * (int64_t)b) + 0x80000000) >> 32);
+}
+
+// computes sum - (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x80000000) >> 32)
+static inline int32_t multiply_subtract_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_subtract_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b)
+{
+  return sum - ((((int64_t)a * (int64_t)b) + 0x80000000) >> 32);
+}
+
+// computes (a[31:16] | (b[31:16] >> 16))
+static inline uint32_t pack_16t_16t(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline uint32_t pack_16t_16t(int32_t a, int32_t b)
+{
+  return ((uint32_t)a & 0xFFFF0000) | ((uint32_t)b >> 16);
+}
+
+// computes (a[31:16] | b[15:0])
+static inline uint32_t pack_16t_16b(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline uint32_t pack_16t_16b(int32_t a, int32_t b)
+{
+  return ((uint32_t)a & 0xFFFF0000) | ((uint32_t)b & 0x0000FFFF);
+}
+
+// computes ((a[15:0] << 16) | b[15:0])
+static inline uint32_t pack_16b_16b(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline uint32_t pack_16b_16b(int32_t a, int32_t b)
+{
+  return ((uint32_t)a << 16) | ((uint32_t)b & 0x0000FFFF);
+}
+
+// computes (((a[31:16] + b[31:16]) << 16) | (a[15:0 + b[15:0]))  (saturates)
+static inline uint32_t signed_add_16_and_16(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline uint32_t signed_add_16_and_16(uint32_t a, uint32_t b)
+{
+  int32_t hi = saturate16((int16_t)(a >> 16) + (int16_t)(b >> 16));
+  int32_t lo = saturate16((int16_t)a + (int16_t)b);
+  return pack_16b_16b(hi, lo);
+}
+
+// computes (((a[31:16] - b[31:16]) << 16) | (a[15:0 - b[15:0]))  (saturates)
+static inline int32_t signed_subtract_16_and_16(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_subtract_16_and_16(int32_t a, int32_t b)
+{
+  int32_t hi = saturate16((int16_t)(a >> 16) - (int16_t)(b >> 16));
+  int32_t lo = saturate16((int16_t)a - (int16_t)b);
+  return pack_16b_16b(hi, lo);
+}
+
+// computes (sum + ((a[31:0] * b[15:0]) >> 16))
+static inline int32_t signed_multiply_accumulate_32x16b(int32_t sum, int32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_multiply_accumulate_32x16b(int32_t sum, int32_t a, uint32_t b)
+{
+  return sum + signed_multiply_32x16b(a, b);
+}
+
+// computes (sum + ((a[31:0] * b[31:16]) >> 16))
+static inline int32_t signed_multiply_accumulate_32x16t(int32_t sum, int32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_multiply_accumulate_32x16t(int32_t sum, int32_t a, uint32_t b)
+{
+  return sum + signed_multiply_32x16t(a, b);
+}
+
+// computes ((a[15:0] * b[15:0]) + (a[31:16] * b[31:16]))
+static inline int32_t multiply_16tx16t_add_16bx16b(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16t_add_16bx16b(uint32_t a, uint32_t b)
+{
+  return (int16_t)a * (int16_t)b + (int16_t)(a >> 16) * (int16_t)(b >> 16);
+}
+
+// computes ((a[15:0] * b[31:16]) + (a[31:16] * b[15:0]))
+static inline int32_t multiply_16tx16b_add_16bx16t(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16b_add_16bx16t(uint32_t a, uint32_t b)
+{
+  return (int16_t)a * (int16_t)(b >> 16) + (int16_t)(a >> 16) * (int16_t)b;
+}
+
+// computes ((a[15:0] * b[15:0])
+static inline int32_t multiply_16bx16b(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16bx16b(uint32_t a, uint32_t b)
+{
+  return (int16_t)a * (int16_t)b;
+}
+
+// computes ((a[15:0] * b[31:16])
+static inline int32_t multiply_16bx16t(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16bx16t(uint32_t a, uint32_t b)
+{
+  return (int16_t)a * (int16_t)(b >> 16);
+}
+
+// computes ((a[31:16] * b[15:0])
+static inline int32_t multiply_16tx16b(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16b(uint32_t a, uint32_t b)
+{
+  return (int16_t)(a >> 16) * (int16_t)b;
+}
+
+// computes ((a[31:16] * b[31:16])
+static inline int32_t multiply_16tx16t(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16t(uint32_t a, uint32_t b)
+{
+  return (int16_t)(a >> 16) * (int16_t)(b >> 16);
+}
+
+// computes (a - b), result saturated to 32 bit integer range
+static inline int32_t substract_32_saturate(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t substract_32_saturate(uint32_t a, uint32_t b)
+{
+  int64_t r = (int64_t)(int32_t)a - (int64_t)(int32_t)b;
+  if (r > INT32_MAX) r = INT32_MAX;
+  else if (r < INT32_MIN) r = INT32_MIN;
+  return r;
+}
+
+#endif
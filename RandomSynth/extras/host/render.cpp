@@ -0,0 +1,196 @@
+// Offline renderer: drives Synth<N> through a score on the host and writes a
+// stereo WAV, as fast as the CPU allows.
+//
+//   randomsynth_render [-v voices] [-s seed] [-d seconds] [-f score] out.wav
+//
+// A score is a text file with one event per line, times in milliseconds:
+//
+//   0     patch                  # createRandomPatch()
+//   0     on 60 100              # noteOn(note, velocity)
+//   300   off 60                 # noteOff(note)
+//   100   touch 60 90            # noteAftertouch(note, value)
+//   100   bend 4096              # pitchBend(-8192..8191)
+//   100   macro1 64              # macroOneControl(value), macro2 likewise
+//   100   set 80 Filter Frequency  # parameter setter by name
+//
+// Without a score the renderer plays what the example sketch does: a random
+// patch, then middle C for 300 ms on / 300 ms off.
+#include <Arduino.h>
+#include <synth.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "wav_file.h"
+
+struct ScoreEvent {
+  uint32_t ms;
+  std::string command;
+  float a = 0;
+  float b = 0;
+  std::string name;
+};
+
+static bool loadScore(const char *path, std::vector<ScoreEvent> &score) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    std::istringstream fields(line);
+    ScoreEvent event;
+    if (!(fields >> event.ms >> event.command)) continue;
+    fields >> event.a >> event.b;
+    if (event.command == "set") {
+      // "set <value> <parameter name with spaces>"
+      std::istringstream rest(line);
+      std::string skip;
+      rest >> skip >> skip >> skip;
+      std::getline(rest >> std::ws, event.name);
+      while (!event.name.empty() && isspace((unsigned char)event.name.back())) event.name.pop_back();
+    }
+    score.push_back(event);
+  }
+  std::stable_sort(score.begin(), score.end(), [](const ScoreEvent &x, const ScoreEvent &y) {
+    return x.ms < y.ms;
+  });
+  return true;
+}
+
+static void exampleScore(std::vector<ScoreEvent> &score, uint32_t durationMs) {
+  score.push_back({ 0, "patch" });
+  for (uint32_t t = 0; t < durationMs; t += 600) {
+    score.push_back({ t, "on", 60, 100 });
+    score.push_back({ t + 300, "off", 60 });
+  }
+}
+
+template<int numVoices>
+static int render(const std::vector<ScoreEvent> &score, float seconds, const char *outPath) {
+  // Audio objects register themselves for the lifetime of the program, as
+  // on the Teensy, so the synth is never destroyed.
+  Synth<numVoices> *synth = new Synth<numVoices>;
+  synth->begin();
+
+  WavWriter wav;
+  if (!wav.open(outPath, AUDIO_SAMPLE_RATE_EXACT, 2)) {
+    fprintf(stderr, "cannot write %s\n", outPath);
+    return 1;
+  }
+
+  const uint32_t blocks = seconds * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES;
+  const uint32_t startMs = millis();
+  size_t next = 0;
+  int16_t left[AUDIO_BLOCK_SAMPLES], right[AUDIO_BLOCK_SAMPLES];
+  int16_t interleaved[AUDIO_BLOCK_SAMPLES * 2];
+
+  auto started = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < blocks; n++) {
+    while (next < score.size() && score[next].ms <= millis() - startMs) {
+      const ScoreEvent &e = score[next++];
+      if (e.command == "on") {
+        synth->noteOn(e.a, e.b);
+      } else if (e.command == "off") {
+        synth->noteOff(e.a);
+      } else if (e.command == "touch") {
+        synth->noteAftertouch(e.a, e.b);
+      } else if (e.command == "bend") {
+        synth->pitchBend(e.a);
+      } else if (e.command == "patch") {
+        synth->createRandomPatch();
+      } else if (e.command == "macro1") {
+        synth->macroOneControl(e.a);
+      } else if (e.command == "macro2") {
+        synth->macroTwoControl(e.a);
+      } else if (e.command == "set") {
+        bool found = false;
+        for (auto &param : synth->parameters) {
+          if (param.name == e.name.c_str()) {
+            param.setterFunction(e.a);
+            param.currentValue = e.a;
+            found = true;
+          }
+        }
+        if (!found) fprintf(stderr, "unknown parameter \"%s\"\n", e.name.c_str());
+      } else {
+        fprintf(stderr, "unknown score command \"%s\"\n", e.command.c_str());
+      }
+    }
+
+    AudioStream::update_all();
+    AudioOutputI2S::readBlock(left, right);
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      interleaved[i * 2] = left[i];
+      interleaved[i * 2 + 1] = right[i];
+    }
+    wav.write(interleaved, AUDIO_BLOCK_SAMPLES);
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  wav.close();
+
+  double audioSeconds = (double)blocks * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT;
+  fprintf(stderr, "%d voices: rendered %.2f s in %.3f s (%.1fx real time), peak audio memory %u blocks, peak string memory %u samples\n",
+          numVoices, audioSeconds, elapsed, elapsed > 0 ? audioSeconds / elapsed : 0.0,
+          (unsigned)AudioMemoryUsageMax(), (unsigned)synth->stringMemoryUsageMax());
+  return 0;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: randomsynth_render [-v 8|16|32|64] [-s seed] [-d seconds] [-f score] out.wav\n");
+}
+
+int main(int argc, char **argv) {
+  int voices = 8;
+  uint32_t seed = 1;
+  float seconds = 10;
+  const char *scorePath = nullptr;
+  const char *outPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-v" && i + 1 < argc) {
+      voices = atoi(argv[++i]);
+    } else if (arg == "-s" && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 0);
+    } else if (arg == "-d" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "-f" && i + 1 < argc) {
+      scorePath = argv[++i];
+    } else if (arg[0] != '-' && !outPath) {
+      outPath = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (!outPath || seconds <= 0) {
+    usage();
+    return 1;
+  }
+
+  std::vector<ScoreEvent> score;
+  if (scorePath) {
+    if (!loadScore(scorePath, score)) {
+      fprintf(stderr, "cannot read score %s\n", scorePath);
+      return 1;
+    }
+  } else {
+    exampleScore(score, seconds * 1000);
+  }
+
+  static std::vector<audio_block_t> memory(600);
+  AudioStream::initialize_memory(memory.data(), memory.size());
+  randomSeed(seed);
+
+  switch (voices) {
+    case 8: return render<8>(score, seconds, outPath);
+    case 16: return render<16>(score, seconds, outPath);
+    case 32: return render<32>(score, seconds, outPath);
+    case 64: return render<64>(score, seconds, outPath);
+  }
+  usage();
+  return 1;
+}
@@ -0,0 +1,200 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Minimal 16 bit PCM WAV writer for the host tools. The header is written
+// with placeholder sizes and patched in close().
+class WavWriter {
+public:
+  bool open(const char *path, uint32_t sampleRate, uint16_t channels) {
+    file = fopen(path, "wb");
+    if (!file) return false;
+    this->sampleRate = sampleRate;
+    this->channels = channels;
+    dataBytes = 0;
+    writeHeader();
+    return true;
+  }
+
+  void write(const int16_t *interleaved, uint32_t frames) {
+    fwrite(interleaved, sizeof(int16_t) * channels, frames, file);
+    dataBytes += frames * channels * sizeof(int16_t);
+  }
+
+  void close() {
+    if (!file) return;
+    fseek(file, 0, SEEK_SET);
+    writeHeader();
+    fclose(file);
+    file = nullptr;
+  }
+
+  ~WavWriter() {
+    close();
+  }
+
+private:
+  void put32(uint32_t v) {
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    fwrite(b, 1, 4, file);
+  }
+
+  void put16(uint16_t v) {
+    uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+    fwrite(b, 1, 2, file);
+  }
+
+  void writeHeader() {
+    fwrite("RIFF", 1, 4, file);
+    put32(36 + dataBytes);
+    fwrite("WAVEfmt ", 1, 8, file);
+    put32(16);
+    put16(1);  // PCM
+    put16(channels);
+    put32(sampleRate);
+    put32(sampleRate * channels * sizeof(int16_t));
+    put16(channels * sizeof(int16_t));
+    put16(16);
+    fwrite("data", 1, 4, file);
+    put32(dataBytes);
+  }
+
+  FILE *file = nullptr;
+  uint32_t sampleRate = 0;
+  uint16_t channels = 0;
+  uint32_t dataBytes = 0;
+};
+
+// Streaming WAV reader for the host tools: 8, 16, 24 and 32 bit PCM and 32
+// bit float, plain or WAVE_FORMAT_EXTENSIBLE. Channels are averaged to one.
+class WavReader {
+public:
+  bool open(const char *path) {
+    close();
+    file = fopen(path, "rb");
+    if (!file) return false;
+    uint8_t riff[12];
+    if (fread(riff, 1, 12, file) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+      close();
+      return false;
+    }
+    long dataStart = -1;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, 8, file) == 8) {
+      uint32_t size = get32(chunk + 4);
+      long next = ftell(file) + size + (size & 1);
+      if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+        uint8_t fmt[40] = {};
+        if (fread(fmt, 1, size < sizeof(fmt) ? size : sizeof(fmt), file) < 16) break;
+        format = get16(fmt);
+        if (format == 0xFFFE && size >= 26) format = get16(fmt + 24);  // the sub-format GUID starts with it
+        channels = get16(fmt + 2);
+        sampleRate = get32(fmt + 4);
+        bits = get16(fmt + 14);
+      } else if (!memcmp(chunk, "clm ", 4)) {
+        // Wavetable editors note the frame size here, as "<!>2048 ..."
+        char text[32] = {};
+        if (fread(text, 1, size < sizeof(text) - 1 ? size : sizeof(text) - 1, file) && !memcmp(text, "<!>", 3)) {
+          cycle = atoi(text + 3);
+        }
+      } else if (!memcmp(chunk, "data", 4)) {
+        dataStart = ftell(file);
+        dataBytes = size;
+      }
+      if (fseek(file, next, SEEK_SET)) break;
+    }
+    bool pcm = format == 1 && bits >= 8 && bits <= 32 && bits % 8 == 0;
+    bool ieee = format == 3 && bits == 32;
+    if (dataStart < 0 || channels == 0 || !(pcm || ieee) || fseek(file, dataStart, SEEK_SET)) {
+      close();
+      return false;
+    }
+    remaining = frames();
+    return true;
+  }
+
+  // Sample frames in the file
+  uint32_t frames() const {
+    return channels ? dataBytes / (channels * (bits / 8)) : 0;
+  }
+
+  // Samples per wavetable frame from a "clm " chunk, 0 if there is none
+  int cycleLength() const {
+    return cycle;
+  }
+
+  uint32_t rate() const {
+    return sampleRate;
+  }
+
+  // Up to count samples scaled to -1.0..1.0, returns how many were read
+  uint32_t read(double *out, uint32_t count) {
+    const int bytes = bits / 8;
+    uint8_t buffer[4096];
+    const uint32_t perRead = sizeof(buffer) / (bytes * channels);
+    uint32_t done = 0;
+    while (done < count && remaining > 0) {
+      uint32_t n = count - done;
+      if (n > perRead) n = perRead;
+      if (n > remaining) n = remaining;
+      if (fread(buffer, bytes * channels, n, file) != n) {
+        remaining = 0;
+        break;
+      }
+      for (uint32_t i = 0; i < n; i++) {
+        double sum = 0;
+        for (int c = 0; c < channels; c++) sum += sample(buffer + (i * channels + c) * bytes);
+        out[done + i] = sum / channels;
+      }
+      done += n;
+      remaining -= n;
+    }
+    return done;
+  }
+
+  void close() {
+    if (file) fclose(file);
+    file = nullptr;
+    format = channels = bits = 0;
+    dataBytes = remaining = 0;
+    cycle = 0;
+  }
+
+  ~WavReader() {
+    close();
+  }
+
+private:
+  static uint16_t get16(const uint8_t *b) {
+    return b[0] | (b[1] << 8);
+  }
+
+  static uint32_t get32(const uint8_t *b) {
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+  }
+
+  double sample(const uint8_t *b) const {
+    if (format == 3) {
+      uint32_t raw = get32(b);
+      float f;
+      memcpy(&f, &raw, sizeof(f));
+      return f;
+    }
+    if (bits == 8) return (b[0] - 128) / 128.0;  // 8 bit WAVs are unsigned
+    // sign extend from the top byte
+    uint32_t value = 0;
+    for (int i = bits / 8 - 1; i >= 0; i--) value = (value << 8) | b[i];
+    return (int32_t)(value << (32 - bits)) / 2147483648.0;
+  }
+
+  FILE *file = nullptr;
+  uint16_t format = 0;
+  uint16_t channels = 0;
+  uint16_t bits = 0;
+  uint32_t sampleRate = 0;
+  uint32_t dataBytes = 0;
+  uint32_t remaining = 0;
+  int cycle = 0;
+};
@@ -0,0 +1,221 @@
+// Converts a multi-frame wavetable WAV, as wavetable editors export them,
+// into tables RandomSynth can play.
+//
+//   randomsynth_import [-f frame] [-l levels] [-j threads] [-k] (-o wavetables.h | -b library.rswt) in.wav
+//
+// The WAV is a run of single-cycle frames, 2048 samples each unless -f or
+// the file's "clm " chunk says otherwise. Each frame is resampled to 256
+// points by keeping its harmonics below the new Nyquist, so nothing folds
+// back, and scaled to full scale; -k keeps the file's own levels instead.
+//
+// -o writes a header laid out like wavetables.h, to replace it and run
+// randomsynth_mipmaps on. -b writes a library file for WavetableFile
+// directly, with -l band-limited levels (8 by default) made from the same
+// harmonics. The file is read and written a batch of frames at a time, and
+// the frames in a batch are converted on -j threads (all cores by default),
+// so banks of any size fit in memory.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include "wav_file.h"
+#include "wavetable_pack.h"
+
+static const int SAMPLES = 256;  // plus the guard sample repeating the first
+static const int HARMONICS = SAMPLES / 2;
+
+struct ImportOptions {
+  int frame = 0;  // 0 takes the clm chunk, else 2048
+  int levels = 8;
+  bool keepLevels = false;
+};
+
+// cos and sin of 2 pi k / n for k = 0..n-1, so the transforms are table
+// lookups
+struct Twiddles {
+  explicit Twiddles(int n)
+    : n(n), cosine(n), sine(n) {
+    for (int k = 0; k < n; k++) {
+      cosine[k] = cos(2 * M_PI * k / n);
+      sine[k] = sin(2 * M_PI * k / n);
+    }
+  }
+  int n;
+  std::vector<double> cosine, sine;
+};
+
+// One frame as levels tables of 257 samples. Level 0 keeps harmonics 1 to
+// 127 (and DC); level k keeps 128 >> k, as randomsynth_mipmaps makes them.
+// All levels share one gain, so a note does not jump in level between
+// octaves.
+static void convertFrame(const double *frame, const Twiddles &in, const Twiddles &out,
+                         const ImportOptions &options, int16_t *tables) {
+  const int n = in.n;
+  double re[HARMONICS], im[HARMONICS];
+  for (int h = 0; h < HARMONICS; h++) {
+    double sumRe = 0, sumIm = 0;
+    int k = 0;
+    for (int i = 0; i < n; i++) {
+      sumRe += frame[i] * in.cosine[k];
+      sumIm += frame[i] * in.sine[k];
+      k += h;
+      if (k >= n) k -= n;
+    }
+    double scale = h == 0 ? 1.0 / n : 2.0 / n;
+    re[h] = sumRe * scale;
+    im[h] = sumIm * scale;
+  }
+
+  std::vector<double> limited(options.levels * SAMPLES);
+  double peak = 0;
+  for (int level = 0; level < options.levels; level++) {
+    int maxHarmonic = level == 0 ? HARMONICS - 1 : HARMONICS >> level;
+    double *table = &limited[level * SAMPLES];
+    for (int s = 0; s < SAMPLES; s++) {
+      double sum = 0;
+      int k = 0;
+      for (int h = 0; h <= maxHarmonic; h++) {
+        sum += re[h] * out.cosine[k] + im[h] * out.sine[k];
+        k += s;
+        if (k >= SAMPLES) k -= SAMPLES;
+      }
+      table[s] = sum;
+      peak = fmax(peak, fabs(sum));
+    }
+  }
+
+  // Full scale, or the file's own level turned down only if band limiting
+  // pushed a peak past it
+  double gain = 32767;
+  if (peak > 0 && (!options.keepLevels || peak > 1.0)) gain = 32767 / peak;
+  for (int level = 0; level < options.levels; level++) {
+    int16_t *table = tables + level * (SAMPLES + 1);
+    for (int s = 0; s < SAMPLES; s++) {
+      long value = lround(limited[level * SAMPLES + s] * gain);
+      table[s] = value > 32767 ? 32767 : value < -32768 ? -32768 : value;
+    }
+    table[SAMPLES] = table[0];
+  }
+}
+
+static void writeHeaderTable(FILE *f, const int16_t *table, bool last) {
+  fprintf(f, "  {");
+  for (int n = 0; n <= SAMPLES; n++) {
+    fprintf(f, n % 10 == 0 ? "\n    " : " ");
+    fprintf(f, "%6d%s", table[n], n < SAMPLES ? "," : "");
+  }
+  fprintf(f, "\n  }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char **argv) {
+  ImportOptions options;
+  int threads = std::thread::hardware_concurrency();
+  const char *headerPath = NULL;
+  const char *libraryPath = NULL;
+  const char *inPath = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+      options.frame = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+      options.levels = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-k")) {
+      options.keepLevels = true;
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      headerPath = argv[++i];
+    } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      libraryPath = argv[++i];
+    } else {
+      inPath = argv[i];
+    }
+  }
+  if (!inPath || (!headerPath == !libraryPath) || options.levels < 1 || options.levels > 8 || options.frame < 0) {
+    fprintf(stderr, "usage: randomsynth_import [-f frame] [-l levels 1..8] [-j threads] [-k] (-o wavetables.h | -b library.rswt) in.wav\n");
+    return 1;
+  }
+  // a header holds level 0 only; randomsynth_mipmaps makes the rest
+  if (headerPath) options.levels = 1;
+  if (threads < 1) threads = 1;
+
+  WavReader wav;
+  if (!wav.open(inPath)) {
+    fprintf(stderr, "%s: not a PCM or float WAV\n", inPath);
+    return 1;
+  }
+  if (!options.frame) options.frame = wav.cycleLength() > 0 ? wav.cycleLength() : 2048;
+  if (options.frame < SAMPLES) {
+    fprintf(stderr, "%s: %d sample frames are shorter than a table\n", inPath, options.frame);
+    return 1;
+  }
+  uint32_t count = wav.frames() / options.frame;
+  if (count == 0) {
+    fprintf(stderr, "%s: no whole %d sample frame\n", inPath, options.frame);
+    return 1;
+  }
+  if (wav.frames() % options.frame) {
+    fprintf(stderr, "%s: ignoring %u samples after the last whole frame\n", inPath, wav.frames() % options.frame);
+  }
+
+  const char *outPath = headerPath ? headerPath : libraryPath;
+  FILE *f = fopen(outPath, headerPath ? "w" : "wb");
+  if (!f) {
+    perror(outPath);
+    return 1;
+  }
+  if (headerPath) {
+    fprintf(f, "#pragma once\n\n");
+    fprintf(f, "// Imported from %s by extras/host/wavetable_import.cpp\n\n", inPath);
+    fprintf(f, "const int16_t waveform[%u][257] = {\n", count);
+  } else {
+    writeLibraryHeader(f, count, options.levels);
+  }
+
+  const Twiddles in(options.frame), out(SAMPLES);
+  const int tableSamples = options.levels * (SAMPLES + 1);
+  const int batch = threads * 16;
+  std::vector<double> frames((size_t)batch * options.frame);
+  std::vector<int16_t> tables((size_t)batch * tableSamples);
+  for (uint32_t first = 0; first < count; first += batch) {
+    int n = count - first < (uint32_t)batch ? count - first : batch;
+    if (wav.read(frames.data(), (uint32_t)n * options.frame) != (uint32_t)n * options.frame) {
+      fprintf(stderr, "%s: file ends early\n", inPath);
+      fclose(f);
+      return 1;
+    }
+
+    // frames interleaved across the workers, each writing only its own tables
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads && t < n; t++) {
+      workers.emplace_back([&, t] {
+        for (int i = t; i < n; i += threads) {
+          convertFrame(&frames[(size_t)i * options.frame], in, out, options, &tables[(size_t)i * tableSamples]);
+        }
+      });
+    }
+    for (std::thread &worker : workers) worker.join();
+
+    for (int i = 0; i < n; i++) {
+      const int16_t *frameTables = &tables[(size_t)i * tableSamples];
+      if (headerPath) {
+        writeHeaderTable(f, frameTables, first + i == count - 1);
+      } else {
+        for (int level = 0; level < options.levels; level++) {
+          PackedWavetable packed;
+          packWavetable(frameTables + level * (SAMPLES + 1), packed);
+          writeLibraryRecord(f, packed);
+        }
+      }
+    }
+  }
+  if (headerPath) fprintf(f, "};\n");
+  if (fclose(f)) {
+    perror(outPath);
+    return 1;
+  }
+  printf("%s: %u tables from %d sample frames\n", outPath, count, options.frame);
+  return 0;
+}
@@ -0,0 +1,307 @@
+// Builds band-limited copies of every table in wavetables.h and writes them
+// delta coded as wavetable_packed.h for WavetableCache, which is what Synth
+// plays. -b writes the packed tables as a library file for WavetableFile
+// instead of a header, and -s the spectral features of every table for
+// WavetableIndex. Given a path, it also writes the copies unpacked, which
+// nothing in the library reads.
+//
+//   randomsynth_mipmaps [-l levels] [-p packed.h] [-b library.rswt] [-s features.h] [mipmaps.h]
+//
+// Level 0 is the original table. Each level after it keeps half the
+// harmonics of the one before, so level k is clean up to
+// AUDIO_SAMPLE_RATE / 2 / (128 >> k): 172 Hz for level 0, 345 Hz for level
+// 1 and so on, and the last of 8 levels is a sine good to 22 kHz.
+//
+// The build regenerates the packed tables and features and fails if the
+// copies in RandomSynth/ are out of date; `cmake --build build --target
+// update_wavetable_mipmaps` refreshes them.
+#include <Arduino.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <wavetables.h>
+#include <wavetable_cache.h>
+#include <wavetable_index.h>
+#include <algorithm>
+#include "wavetable_pack.h"
+
+static const int TABLES = sizeof(waveform) / sizeof(waveform[0]);
+static const int SAMPLES = 256;  // plus the guard sample repeating the first
+static const int HARMONICS = SAMPLES / 2;
+
+// Table t with only harmonics 0..maxHarmonic, as doubles
+static void bandLimit(int t, int maxHarmonic, double *out) {
+  for (int n = 0; n < SAMPLES; n++) out[n] = 0;
+  for (int h = 0; h <= maxHarmonic; h++) {
+    double re = 0, im = 0;
+    for (int n = 0; n < SAMPLES; n++) {
+      double angle = 2 * M_PI * h * n / SAMPLES;
+      re += waveform[t][n] * cos(angle);
+      im += waveform[t][n] * sin(angle);
+    }
+    // the DC and Nyquist terms have no mirror image
+    double scale = (h == 0 || h == HARMONICS) ? 1.0 / SAMPLES : 2.0 / SAMPLES;
+    for (int n = 0; n < SAMPLES; n++) {
+      double angle = 2 * M_PI * h * n / SAMPLES;
+      out[n] += scale * (re * cos(angle) + im * sin(angle));
+    }
+  }
+}
+
+// Power in harmonics 1..HARMONICS of table t, as a share of the total
+static void powerSpectrum(int t, double *power) {
+  double total = 0;
+  for (int h = 1; h <= HARMONICS; h++) {
+    double re = 0, im = 0;
+    for (int n = 0; n < SAMPLES; n++) {
+      double angle = 2 * M_PI * h * n / SAMPLES;
+      re += waveform[t][n] * cos(angle);
+      im += waveform[t][n] * sin(angle);
+    }
+    power[h] = re * re + im * im;
+    total += power[h];
+  }
+  power[0] = 0;
+  for (int h = 1; h <= HARMONICS; h++) power[h] = total > 0 ? power[h] / total : 0;
+}
+
+// Features of every table, the tables darkest first, and each table's
+// nearest neighbours by Hellinger distance between power spectra, which
+// ignores phase and level and weighs quiet harmonics in proportion
+static bool writeFeatures(const char *path) {
+  std::vector<double> power(TABLES * (HARMONICS + 1));
+  std::vector<WavetableFeatures> features(TABLES);
+  for (int t = 0; t < TABLES; t++) {
+    double *p = &power[t * (HARMONICS + 1)];
+    powerSpectrum(t, p);
+    double centroid = 0;
+    for (int h = 1; h <= HARMONICS; h++) centroid += h * p[h];
+    features[t].centroid = lround(centroid * 256);
+    for (int band = 0; band < WAVETABLE_BANDS; band++) {
+      int from = 1 << band;
+      int to = band == WAVETABLE_BANDS - 1 ? HARMONICS : (2 << band) - 1;
+      double share = 0;
+      for (int h = from; h <= to; h++) share += p[h];
+      features[t].bands[band] = lround(share * 255);
+    }
+  }
+  std::vector<double> roots(power.size());
+  for (size_t i = 0; i < power.size(); i++) roots[i] = sqrt(power[i]);
+  for (int t = 0; t < TABLES; t++) {
+    std::vector<std::pair<double, int>> distance;
+    for (int other = 0; other < TABLES; other++) {
+      if (other == t) continue;
+      double d = 0;
+      for (int h = 1; h <= HARMONICS; h++) {
+        double diff = roots[t * (HARMONICS + 1) + h] - roots[other * (HARMONICS + 1) + h];
+        d += diff * diff;
+      }
+      distance.emplace_back(d, other);
+    }
+    std::sort(distance.begin(), distance.end());
+    for (int k = 0; k < WAVETABLE_NEIGHBOURS; k++) {
+      // a bank too small to have that many points back at the table itself
+      features[t].neighbours[k] = k < (int)distance.size() ? distance[k].second : t;
+    }
+  }
+  std::vector<int> byCentroid(TABLES);
+  for (int t = 0; t < TABLES; t++) byCentroid[t] = t;
+  std::stable_sort(byCentroid.begin(), byCentroid.end(),
+                   [&](int a, int b) { return features[a].centroid < features[b].centroid; });
+
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "#pragma once\n");
+  fprintf(f, "#include \"wavetable_index.h\"\n\n");
+  fprintf(f, "// Generated from wavetables.h by extras/host/wavetable_mipmaps.cpp, do not\n");
+  fprintf(f, "// edit. { centroid, { bands }, { neighbours } } for each table.\n\n");
+  fprintf(f, "const WavetableFeatures wavetableFeatures[%d] = {\n", TABLES);
+  for (int t = 0; t < TABLES; t++) {
+    const WavetableFeatures &w = features[t];
+    fprintf(f, "  { %4d, {", w.centroid);
+    for (int band = 0; band < WAVETABLE_BANDS; band++) fprintf(f, " %3d%s", w.bands[band], band < WAVETABLE_BANDS - 1 ? "," : "");
+    fprintf(f, " }, {");
+    for (int k = 0; k < WAVETABLE_NEIGHBOURS; k++) fprintf(f, " %3d%s", w.neighbours[k], k < WAVETABLE_NEIGHBOURS - 1 ? "," : "");
+    fprintf(f, " } }%s\n", t == TABLES - 1 ? "" : ",");
+  }
+  fprintf(f, "};\n\n");
+  fprintf(f, "const uint16_t wavetablesByCentroid[%d] = {", TABLES);
+  for (int i = 0; i < TABLES; i++) {
+    fprintf(f, i % 16 == 0 ? "\n  " : " ");
+    fprintf(f, "%d%s", byCentroid[i], i < TABLES - 1 ? "," : "");
+  }
+  fprintf(f, "\n};\n");
+  fclose(f);
+  printf("%s: centroids from %.1f to %.1f harmonics\n", path,
+         features[byCentroid[0]].centroid / 256.0, features[byCentroid[TABLES - 1]].centroid / 256.0);
+  return true;
+}
+
+static void writeTable(FILE *f, const int16_t *table, bool last) {
+  fprintf(f, "    {");
+  for (int n = 0; n <= SAMPLES; n++) {
+    fprintf(f, n % 10 == 0 ? "\n      " : " ");
+    fprintf(f, "%6d%s", table[n], n < SAMPLES ? "," : "");
+  }
+  fprintf(f, "\n    }%s\n", last ? "" : ",");
+}
+
+static void writePacked(FILE *f, const PackedWavetable &packed, bool last) {
+  fprintf(f, "    { %d,\n      {", packed.first);
+  for (int i = 0; i < 16; i++) fprintf(f, " %d%s", packed.shifts[i], i < 15 ? "," : "");
+  fprintf(f, " },\n      {");
+  for (int i = 0; i < 255; i++) {
+    if (i % 16 == 0 && i) fprintf(f, "\n       ");
+    fprintf(f, " %4d%s", packed.delta[i], i < 254 ? "," : "");
+  }
+  fprintf(f, " } }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char **argv) {
+  int levels = 8;
+  const char *path = NULL;
+  const char *packedPath = NULL;
+  const char *libraryPath = NULL;
+  const char *featuresPath = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+      levels = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+      packedPath = argv[++i];
+    } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      libraryPath = argv[++i];
+    } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      featuresPath = argv[++i];
+    } else {
+      path = argv[i];
+    }
+  }
+  if ((!path && !packedPath && !libraryPath && !featuresPath) || levels < 1 || (HARMONICS >> (levels - 1)) < 1) {
+    fprintf(stderr, "usage: randomsynth_mipmaps [-l levels 1..8] [-p packed.h] [-b library.rswt] [-s features.h] [mipmaps.h]\n");
+    return 1;
+  }
+
+  std::vector<int16_t> mipmaps(TABLES * levels * (SAMPLES + 1));
+  double smallestGain = 1.0;
+  double limited[SAMPLES];
+  for (int t = 0; t < TABLES; t++) {
+    // Removing harmonics can push a peak past full scale. All levels of a
+    // table share one gain, so a note does not jump in level as it crosses
+    // an octave; most tables need none and keep level 0 exactly.
+    double peak = 32767;
+    for (int level = 1; level < levels; level++) {
+      bandLimit(t, HARMONICS >> level, limited);
+      for (int n = 0; n < SAMPLES; n++) peak = fmax(peak, fabs(limited[n]));
+    }
+    double gain = 32767 / peak;
+    smallestGain = fmin(smallestGain, gain);
+
+    for (int level = 0; level < levels; level++) {
+      if (level == 0) {
+        for (int n = 0; n < SAMPLES; n++) limited[n] = waveform[t][n];
+      } else {
+        bandLimit(t, HARMONICS >> level, limited);
+      }
+      int16_t *table = &mipmaps[(t * levels + level) * (SAMPLES + 1)];
+      for (int n = 0; n < SAMPLES; n++) table[n] = lround(limited[n] * gain);
+      table[SAMPLES] = table[0];
+    }
+  }
+
+  long original = (long)TABLES * (SAMPLES + 1) * sizeof(int16_t);
+  printf("%d levels, tables turned down by up to %.2f dB\n", levels, -20 * log10(smallestGain));
+
+  if (path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+      perror(path);
+      return 1;
+    }
+    fprintf(f, "#pragma once\n\n");
+    fprintf(f, "// Generated from wavetables.h by extras/host/wavetable_mipmaps.cpp, do not\n");
+    fprintf(f, "// edit. Level k of each table keeps harmonics up to %d >> k.\n\n", HARMONICS);
+    fprintf(f, "#define WAVETABLE_MIPMAP_LEVELS %d\n\n", levels);
+    fprintf(f, "const int16_t waveformMipmaps[%d][WAVETABLE_MIPMAP_LEVELS][257] = {\n", TABLES);
+    for (int t = 0; t < TABLES; t++) {
+      fprintf(f, "  {\n");
+      for (int level = 0; level < levels; level++) {
+        writeTable(f, &mipmaps[(t * levels + level) * (SAMPLES + 1)], level == levels - 1);
+      }
+      fprintf(f, "  }%s\n", t == TABLES - 1 ? "" : ",");
+    }
+    fprintf(f, "};\n");
+    fclose(f);
+    long total = original * levels;
+    printf("%s: %ld bytes of flash, %ld more than wavetables.h\n", path, total, total - original);
+  }
+
+  if (packedPath) {
+    FILE *f = fopen(packedPath, "w");
+    if (!f) {
+      perror(packedPath);
+      return 1;
+    }
+    fprintf(f, "#pragma once\n");
+    fprintf(f, "#include \"wavetable_cache.h\"\n\n");
+    fprintf(f, "// Generated from wavetables.h by extras/host/wavetable_mipmaps.cpp, do not\n");
+    fprintf(f, "// edit. Level k of each table keeps harmonics up to %d >> k, delta coded for\n", HARMONICS);
+    fprintf(f, "// WavetableCache.\n\n");
+    fprintf(f, "#define WAVETABLE_PACKED_LEVELS %d\n\n", levels);
+    fprintf(f, "const PackedWavetable waveformPacked[%d][WAVETABLE_PACKED_LEVELS] = {\n", TABLES);
+    double worst = 1e9;
+    int16_t unpacked[SAMPLES + 1];
+    for (int t = 0; t < TABLES; t++) {
+      fprintf(f, "  {\n");
+      for (int level = 0; level < levels; level++) {
+        const int16_t *table = &mipmaps[(t * levels + level) * (SAMPLES + 1)];
+        PackedWavetable packed;
+        packWavetable(table, packed);
+        writePacked(f, packed, level == levels - 1);
+
+        // check against the decoder the oscillators use
+        WavetableCache::unpack(packed, unpacked);
+        double signal = 0, error = 0;
+        for (int n = 0; n < SAMPLES; n++) {
+          signal += (double)table[n] * table[n];
+          error += (double)(unpacked[n] - table[n]) * (unpacked[n] - table[n]);
+        }
+        if (error > 0) worst = fmin(worst, 10 * log10(signal / error));
+      }
+      fprintf(f, "  }%s\n", t == TABLES - 1 ? "" : ",");
+    }
+    fprintf(f, "};\n");
+    fclose(f);
+    long total = (long)TABLES * levels * sizeof(PackedWavetable);
+    printf("%s: %ld bytes of flash, %ld more than wavetables.h; worst table %.1f dB above its coding error\n",
+           packedPath, total, total - original, worst);
+  }
+  if (featuresPath && !writeFeatures(featuresPath)) return 1;
+
+  if (libraryPath) {
+    FILE *f = fopen(libraryPath, "wb");
+    if (!f) {
+      perror(libraryPath);
+      return 1;
+    }
+    writeLibraryHeader(f, TABLES, levels);
+    for (int t = 0; t < TABLES; t++) {
+      for (int level = 0; level < levels; level++) {
+        PackedWavetable packed;
+        packWavetable(&mipmaps[(t * levels + level) * (SAMPLES + 1)], packed);
+        writeLibraryRecord(f, packed);
+      }
+    }
+    if (fclose(f)) {
+      perror(libraryPath);
+      return 1;
+    }
+    printf("%s: %ld bytes\n", libraryPath, WavetableFile::HEADER_BYTES + (long)TABLES * levels * (long)sizeof(PackedWavetable));
+  }
+  return 0;
+}
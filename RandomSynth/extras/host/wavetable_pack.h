@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <wavetable_cache.h>
+#include <wavetable_file.h>
+
+// Delta coding and library file writing shared by randomsynth_mipmaps and
+// randomsynth_import.
+
+// Closed loop, so rounding never builds up: each delta is taken from the
+// sample the decoder will have, and each block of 8 gets the smallest shift
+// whose deltas fit in 8 bits.
+inline void packWavetable(const int16_t *table, PackedWavetable &packed) {
+  memset(&packed, 0, sizeof(packed));
+  packed.first = table[0];
+  int32_t sample = table[0];
+  for (int block = 0; block < 256 / 8; block++) {
+    for (int shift = 0; shift < 16; shift++) {
+      int32_t trial = sample;
+      bool fits = true;
+      for (int n = block == 0 ? 1 : block * 8; n < block * 8 + 8 && fits; n++) {
+        long delta = lround((table[n] - trial) / (double)(1 << shift));
+        // never step outside 16 bits, the decoder does not saturate
+        while (trial + delta * (1 << shift) > 32767) delta--;
+        while (trial + delta * (1 << shift) < -32768) delta++;
+        if (delta > 127 || delta < -128) {
+          fits = false;
+        } else {
+          packed.delta[n - 1] = delta;
+          trial += delta * (1 << shift);
+        }
+      }
+      if (fits) {
+        packed.shifts[block >> 1] |= shift << ((block & 1) * 4);
+        sample = trial;
+        break;
+      }
+    }
+  }
+}
+
+// The header WavetableFile reads. Write it first, then count * levels
+// records, table-major.
+inline void writeLibraryHeader(FILE *f, uint32_t count, int levels) {
+  uint8_t header[WavetableFile::HEADER_BYTES] = { 'R', 'S', 'W', 'T' };
+  header[4] = WavetableFile::VERSION;
+  header[6] = levels;
+  for (int i = 0; i < 4; i++) header[8 + i] = count >> (8 * i);
+  fwrite(header, sizeof(header), 1, f);
+}
+
+// The record layout WavetableFile reads, whatever the host's struct padding
+inline void writeLibraryRecord(FILE *f, const PackedWavetable &packed) {
+  uint8_t record[sizeof(PackedWavetable)] = {};
+  record[0] = packed.first & 0xFF;
+  record[1] = (packed.first >> 8) & 0xFF;
+  memcpy(record + 2, packed.shifts, 16);
+  memcpy(record + 18, packed.delta, 255);
+  fwrite(record, sizeof(record), 1, f);
+}
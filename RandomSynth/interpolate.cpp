@@ -0,0 +1,112 @@
+#include <Arduino.h>
+#include "interpolate.h"
+#include "utility/dspinst.h"
+
+#if defined(RANDOMSYNTH_HOST) && defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(RANDOMSYNTH_HOST) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// out[i] = (in0[i] * w0 + in1[i] * w1) >> 14, with both Q14 weights moving
+// in a straight line from "from" to "to" and arriving on the last sample.
+// The weights are stepped in 16.16 fixed point and each sample uses the top
+// half, so every path below gives the same result bit for bit.
+static void crossfade(int16_t *out, const int16_t *in0, const int16_t *in1, uint32_t from, uint32_t to)
+{
+	int32_t acc0 = (from & 0xFFFF) << 16;
+	int32_t acc1 = from & 0xFFFF0000;
+	// the block is 128 = 2^7 samples, so the step is the difference << (16 - 7)
+	int32_t step0 = ((int32_t)(to & 0xFFFF) - (int32_t)(from & 0xFFFF)) << 9;
+	int32_t step1 = ((int32_t)(to >> 16) - (int32_t)(from >> 16)) << 9;
+
+#if defined(RANDOMSYNTH_HOST) && defined(__SSE2__)
+	// pmaddwd multiplies interleaved (in0, in1) pairs by (w0, w1) pairs and
+	// adds each pair, four samples per instruction
+	__m128i weights0 = _mm_setr_epi32(acc0 + step0, acc0 + 2 * step0, acc0 + 3 * step0, acc0 + 4 * step0);
+	__m128i weights1 = _mm_setr_epi32(acc1 + step1, acc1 + 2 * step1, acc1 + 3 * step1, acc1 + 4 * step1);
+	const __m128i increment0 = _mm_set1_epi32(4 * step0);
+	const __m128i increment1 = _mm_set1_epi32(4 * step1);
+	const __m128i top = _mm_set1_epi32(0xFFFF0000);
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(in0 + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(in1 + i));
+		__m128i w = _mm_or_si128(_mm_srli_epi32(weights0, 16), _mm_and_si128(weights1, top));
+		__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w);
+		weights0 = _mm_add_epi32(weights0, increment0);
+		weights1 = _mm_add_epi32(weights1, increment1);
+		w = _mm_or_si128(_mm_srli_epi32(weights0, 16), _mm_and_si128(weights1, top));
+		__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w);
+		weights0 = _mm_add_epi32(weights0, increment0);
+		weights1 = _mm_add_epi32(weights1, increment1);
+		lo = _mm_srai_epi32(lo, 14);
+		hi = _mm_srai_epi32(hi, 14);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(lo, hi));
+	}
+#elif defined(RANDOMSYNTH_HOST) && defined(__ARM_NEON)
+	int32_t start0[4] = { acc0 + step0, acc0 + 2 * step0, acc0 + 3 * step0, acc0 + 4 * step0 };
+	int32_t start1[4] = { acc1 + step1, acc1 + 2 * step1, acc1 + 3 * step1, acc1 + 4 * step1 };
+	int32x4_t weights0 = vld1q_s32(start0);
+	int32x4_t weights1 = vld1q_s32(start1);
+	const int32x4_t increment0 = vdupq_n_s32(4 * step0);
+	const int32x4_t increment1 = vdupq_n_s32(4 * step1);
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 4) {
+		int32x4_t sum = vmull_s16(vld1_s16(in0 + i), vshrn_n_s32(weights0, 16));
+		sum = vmlal_s16(sum, vld1_s16(in1 + i), vshrn_n_s32(weights1, 16));
+		vst1_s16(out + i, vqshrn_n_s32(sum, 14));
+		weights0 = vaddq_s32(weights0, increment0);
+		weights1 = vaddq_s32(weights1, increment1);
+	}
+#else
+	// two samples per iteration, one dual 16 bit multiply-accumulate each
+	const uint32_t *p0 = (const uint32_t *)in0;
+	const uint32_t *p1 = (const uint32_t *)in1;
+	uint32_t *dest = (uint32_t *)out;
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES / 2; i++) {
+		uint32_t a = *p0++;
+		uint32_t b = *p1++;
+		acc0 += step0;
+		acc1 += step1;
+		int32_t first = multiply_16tx16t_add_16bx16b(pack_16b_16b(b, a), pack_16t_16t(acc1, acc0));
+		acc0 += step0;
+		acc1 += step1;
+		int32_t second = multiply_16tx16t_add_16bx16b(pack_16t_16t(b, a), pack_16t_16t(acc1, acc0));
+		*dest++ = pack_16b_16b(signed_saturate_rshift(second, 16, 14), signed_saturate_rshift(first, 16, 14));
+	}
+#endif
+}
+
+// Weights that pass one input straight through
+#define ONLY_INPUT_0 0x00004000
+#define ONLY_INPUT_1 0x40000000
+
+void AudioInterpolate::update(void)
+{
+	audio_block_t *block1, *block2, *output;
+	static const int16_t silence[AUDIO_BLOCK_SAMPLES] = {};
+
+	block1 = receiveReadOnly(0);  // Receive data from the first oscillator
+	block2 = receiveReadOnly(1);  // Receive data from the second oscillator
+
+	uint32_t from = currentWeights;
+	uint32_t to = targetWeights;
+	currentWeights = to;
+
+	if (from == to && (to == ONLY_INPUT_0 || to == ONLY_INPUT_1)) {
+		// Settled on one input: forward its block, no copy and no math
+		audio_block_t *selected = (to == ONLY_INPUT_0) ? block1 : block2;
+		if (selected) transmit(selected);
+	} else if (block1 || block2) {
+		// A missing block is silence, so the other input still fades in
+		// and out rather than the output dropping out
+		output = allocate();
+		if (output) {
+			crossfade(output->data, block1 ? block1->data : silence,
+				block2 ? block2->data : silence, from, to);
+			transmit(output);  // Send the mixed signal to the output
+			release(output);
+		}
+	}
+	if (block1) release(block1);
+	if (block2) release(block2);
+}
@@ -1,6 +1,10 @@
 #pragma once
 #include <Audio.h>
 
+// Crossfades two inputs: factor 0 gives input 0, 1 gives input 1. A new
+// factor ramps in across the next block, so driving it from aftertouch
+// does not zip. At exactly 0 or 1 the chosen input's block is passed on
+// untouched, and a missing input block counts as silence.
 class AudioInterpolate : public AudioStream {
 public:
   AudioInterpolate()
@@ -11,38 +15,34 @@ public:
     if (factor < 0.0) factor = 0.0;
     if (factor > 1.0) factor = 1.0;
     interpolationFactor = factor;
+    updateWeights();
   }
 
-  virtual void update() {
-    audio_block_t *block1, *block2;
-
-    block1 = receiveReadOnly(0);  // Receive data from the first oscillator
-    block2 = receiveReadOnly(1);  // Receive data from the second oscillator
-
-    if (block1 && block2) {
-      audio_block_t *output = allocate();
-      if (output) {
-        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-          int32_t interpolatedValue = (int32_t)(block1->data[i] * (1.0 - interpolationFactor)) + (int32_t)(block2->data[i] * interpolationFactor);
+  // Sine/cosine weights keep the level of unrelated inputs steady through
+  // the fade, where the default linear weights dip 3 dB at the middle
+  void equalPower(bool enable) {
+    equalPowerCurve = enable;
+    updateWeights();
+  }
 
-          // Basic clipping protection
-          if (interpolatedValue > 32767) interpolatedValue = 32767;
-          else if (interpolatedValue < -32768) interpolatedValue = -32768;
+  virtual void update();
 
-          output->data[i] = (int16_t)interpolatedValue;
-        }
-        transmit(output);  // Send the mixed signal to the output
-        release(output);
-      }
-      release(block1);
-      release(block2);
-    } else {
-      if (block1) release(block1);
-      if (block2) release(block2);
+private:
+  void updateWeights() {
+    float weight0 = 1.0f - interpolationFactor;
+    float weight1 = interpolationFactor;
+    if (equalPowerCurve) {
+      weight0 = cosf(interpolationFactor * HALF_PI);
+      weight1 = sinf(interpolationFactor * HALF_PI);
     }
+    // one 32 bit store, so update() never sees half of a change
+    targetWeights = ((uint32_t)(weight1 * 16384.0f + 0.5f) << 16) | (uint32_t)(weight0 * 16384.0f + 0.5f);
   }
 
-private:
   audio_block_t *inputQueueArray[2];
   float interpolationFactor = 0.5;  // Default to an even mix
+  bool equalPowerCurve = false;
+  // Q14 weights, input 1 in the top half and input 0 in the bottom
+  volatile uint32_t targetWeights = 0x20002000;
+  uint32_t currentWeights = 0x20002000;
 };
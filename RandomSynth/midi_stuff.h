@@ -1,4 +1,6 @@
 #pragma once
+#include <stdint.h>
+
 #define MODULATION_WHEEL 1
 #define BREATH_CONTROLLER 2
 #define FOOT_CONTROLLER 4
@@ -48,68 +50,167 @@
 #define REGISTERED_PARAMETER_NUMBER_MSB 101
 // ... and others based on your specific needs
 
-class MPEChannel {
-private:
-  static const int MAX_MPE_CHANNELS = 15;  // Assuming channel 1 is reserved
-  int mpeChannels[MAX_MPE_CHANNELS];
-  bool channelInUse[MAX_MPE_CHANNELS];
-  unsigned long noteTimestamps[MAX_MPE_CHANNELS];  // To keep track of when each note was last assigned
-  unsigned long currentTimestamp;
+// MPE zones, as MIDI Polyphonic Expression 1.0 lays them out. The lower zone
+// is managed on channel 1 and takes member channels upwards from 2; the
+// upper zone is managed on channel 16 and takes them downwards from 15.
+#define MPE_LOWER_ZONE 0
+#define MPE_UPPER_ZONE 1
 
+// Gives each note a member channel of its zone. Free channels are handed
+// out in the order they were released, so a new note lands on the channel
+// that has been quiet longest, and when none is free the note that has held
+// its channel longest gives it up. Every call is a table lookup and a few
+// list links rather than a scan of the channels.
+class MPEChannel {
 public:
-  MPEChannel()
-    : currentTimestamp(0) {
-    for (int i = 0; i < MAX_MPE_CHANNELS; i++) {
-      mpeChannels[i] = -1;  // Initialize with -1 indicating no note is assigned
-      channelInUse[i] = false;
-      noteTimestamps[i] = 0;
-    }
+  MPEChannel() {
+    configure(1, 15);  // one lower zone on every channel, the MPE default
   }
 
-  int assignChannel(int noteNumber) {
-    currentTimestamp++;  // Increment timestamp for each assignment
-    int oldestChannel = 0;
-    unsigned long oldestTime = currentTimestamp;
-
-    // Try to find an available channel
-    for (int i = 0; i < MAX_MPE_CHANNELS; i++) {
-      if (!channelInUse[i]) {
-        mpeChannels[i] = noteNumber;
-        channelInUse[i] = true;
-        noteTimestamps[i] = currentTimestamp;
-        return i + 2;  // +2 because channel 1 is reserved
-      }
+  // An MPE Configuration Message: memberChannels (0 to 15) for the zone
+  // managed on managerChannel, 1 or 16. 0 turns the zone off. A zone that
+  // grows into the other shrinks it, and both start with no notes.
+  void configure(int managerChannel, int memberChannels) {
+    if (managerChannel != 1 && managerChannel != 16) return;
+    if (memberChannels < 0) memberChannels = 0;
+    if (memberChannels > 15) memberChannels = 15;
+    int zone = managerChannel == 1 ? MPE_LOWER_ZONE : MPE_UPPER_ZONE;
+    int other = 1 - zone;
+    zones[zone].members = memberChannels;
+    if (zones[other].members > 14 - memberChannels) {
+      zones[other].members = memberChannels >= 14 ? 0 : 14 - memberChannels;
+    }
 
-      // Track the oldest used channel for potential voice stealing
-      if (noteTimestamps[i] < oldestTime) {
-        oldestChannel = i;
-        oldestTime = noteTimestamps[i];
+    for (int c = 0; c <= 16; c++) {
+      channelNote[c] = -1;
+      channelZone[c] = -1;
+      prev[c] = next[c] = 0;
+    }
+    for (int z = 0; z < 2; z++) {
+      Zone &zn = zones[z];
+      zn.free.head = zn.free.tail = 0;
+      zn.busy.head = zn.busy.tail = 0;
+      for (int n = 0; n < 128; n++) zn.noteChannel[n] = 0;
+      for (int m = 0; m < zn.members; m++) {
+        int channel = z == MPE_LOWER_ZONE ? 2 + m : 15 - m;
+        channelZone[channel] = z;
+        append(zn.free, channel);
       }
     }
+    stolen = -1;
+  }
 
-    // Voice stealing: use the oldest channel if all channels are in use
-    mpeChannels[oldestChannel] = noteNumber;
-    noteTimestamps[oldestChannel] = currentTimestamp;
-    return oldestChannel + 2;
+  // Member channels in a zone, 0 if it is off
+  int memberChannels(int zone) const {
+    return zones[zone].members;
   }
 
-  int releaseChannel(int noteNumber) {
-    for (int i = 0; i < MAX_MPE_CHANNELS; i++) {
-      if (mpeChannels[i] == noteNumber) {
-        channelInUse[i] = false;
-        mpeChannels[i] = -1;
-        return i + 2;  // Return the channel that was being used
-      }
+  // MPE_LOWER_ZONE or MPE_UPPER_ZONE for a member channel, -1 for a
+  // manager channel or one outside both zones
+  int zoneOf(int channel) const {
+    return channel >= 1 && channel <= 16 ? channelZone[channel] : -1;
+  }
+  bool isManager(int channel) const {
+    return (channel == 1 && zones[MPE_LOWER_ZONE].members) || (channel == 16 && zones[MPE_UPPER_ZONE].members);
+  }
+
+  // A channel (1 to 16) for noteNumber, or -1 if the zone is off. A note
+  // already holding a channel keeps it.
+  int assignChannel(int noteNumber, int zone = MPE_LOWER_ZONE) {
+    stolen = -1;
+    if (noteNumber < 0 || noteNumber > 127) return -1;
+    Zone &zn = zones[zone];
+    int channel = zn.noteChannel[noteNumber];
+    if (channel) {
+      unlink(zn.busy, channel);
+    } else if (zn.free.head) {
+      channel = zn.free.head;
+      unlink(zn.free, channel);
+    } else if (zn.busy.head) {
+      // Voice stealing: the oldest note gives up its channel
+      channel = zn.busy.head;
+      unlink(zn.busy, channel);
+      stolen = channelNote[channel];
+      zn.noteChannel[stolen] = 0;
+    } else {
+      return -1;
     }
-    return -1;  // Return -1 if the note was not found
+    append(zn.busy, channel);
+    zn.noteChannel[noteNumber] = channel;
+    channelNote[channel] = noteNumber;
+    return channel;
   }
 
-  int getChannelAssignment(int noteNumber) {
-    for (int i = 0; i < MAX_MPE_CHANNELS; i++) {
-      if (mpeChannels[i] == noteNumber) {
-        return i + 2;  // +2 because channel 1 is reserved
-      }
+  // The note the last assignChannel() took a channel from, or -1
+  int stolenNote() const {
+    return stolen;
+  }
+
+  // Frees the channel of noteNumber and returns it, or -1 if the note had
+  // none
+  int releaseChannel(int noteNumber, int zone = MPE_LOWER_ZONE) {
+    if (noteNumber < 0 || noteNumber > 127) return -1;
+    Zone &zn = zones[zone];
+    int channel = zn.noteChannel[noteNumber];
+    if (!channel) return -1;
+    unlink(zn.busy, channel);
+    append(zn.free, channel);
+    zn.noteChannel[noteNumber] = 0;
+    channelNote[channel] = -1;
+    return channel;
+  }
+
+  // The channel noteNumber holds, or -1
+  int getChannelAssignment(int noteNumber, int zone = MPE_LOWER_ZONE) const {
+    if (noteNumber < 0 || noteNumber > 127) return -1;
+    int channel = zones[zone].noteChannel[noteNumber];
+    return channel ? channel : -1;
+  }
+
+  // The note holding a channel, or -1
+  int getNoteAssignment(int channel) const {
+    return channel >= 1 && channel <= 16 ? channelNote[channel] : -1;
+  }
+
+private:
+  // Ends of a list threaded through prev and next, by channel; 0 is none
+  struct ChannelList {
+    uint8_t head, tail;
+  };
+  struct Zone {
+    int members = 0;
+    ChannelList free;  // oldest released first
+    ChannelList busy;  // oldest assigned first
+    uint8_t noteChannel[128];  // 0 for no channel
+  };
+
+  void append(ChannelList &list, int channel) {
+    prev[channel] = list.tail;
+    next[channel] = 0;
+    if (list.tail) {
+      next[list.tail] = channel;
+    } else {
+      list.head = channel;
     }
-    return -1;  // Return -1 if the note is not assigned to any channel
+    list.tail = channel;
   }
+  void unlink(ChannelList &list, int channel) {
+    if (prev[channel]) {
+      next[prev[channel]] = next[channel];
+    } else {
+      list.head = next[channel];
+    }
+    if (next[channel]) {
+      prev[next[channel]] = prev[channel];
+    } else {
+      list.tail = prev[channel];
+    }
+    prev[channel] = next[channel] = 0;
+  }
+
+  Zone zones[2];
+  uint8_t prev[17], next[17];  // by channel, 1 to 16
+  int8_t channelNote[17];
+  int8_t channelZone[17];
+  int stolen = -1;
 };
@@ -5,26 +5,61 @@
 #include "effect_delay.h"
 #include "input_adc.h"
 #include "voice.h"
+#include "midi_stuff.h"
 #include "envelopeFollower.h"
 #include <Audio.h>
 #include <string>
 #include <vector>
 #include <functional>
-#include "wavetables.h"
+#include "wavetable_packed.h"
+#include "wavetable_features.h"
 
 #define GRANULAR_MEMORY_SIZE 12800  // enough for 290 ms at 44.1 kHz
 
-template<int numVoices>
+// Karplus-Strong delay line memory shared by all voices. A string takes only
+// what its note needs (169 samples at middle C, 1605 at 27.5 Hz), so the
+// average per voice can be well under the longest line.
+#ifndef STRING_MEMORY_PER_VOICE
+#define STRING_MEMORY_PER_VOICE 640
+#endif
+
+// Wavetables unpacked into RAM, each 8 levels of 257 samples (4 KB): the
+// start and end tables, the two rows either side of the scan position, and
+// spares so going back to a recent table unpacks nothing.
+#ifndef WAVETABLE_CACHE_SLOTS
+#define WAVETABLE_CACHE_SLOTS 6
+#endif
+
+// VoicePolicy picks the nodes every voice is built from, FullVoice or a
+// smaller one such as WavetableVoice (see voice.h). Nodes it leaves out,
+// and the strings' bank and memory, are not in the synth at all.
+template<int numVoices, class VoicePolicy = FullVoice>
 
 class Synth {
 private:
   // static constexpr int numVoices = 8;  // Number of voices, up to 64 but probably less
   static constexpr int numSubmixers = (numVoices + 3) / 4;
-  static constexpr int numMixers = (numVoices + 11) / 16;
+  static constexpr int numMixers = (numSubmixers + 3) / 4;
   static constexpr int channelsPerMixer = 4;
   const float PER_CHANNEL_GAIN = 0.2;
-  Voice voices[numVoices];  // Array of voice objects
+  Part<VoicePolicy::string, AudioSynthKarplusStrongBank<numVoices>> strings;  // before the voices, so it updates first
+  AudioSynthModulationBank<numVoices> modulation;  // likewise
+  BasicVoice<VoicePolicy> voices[numVoices];  // Array of voice objects
   int voiceNote[numVoices];
+  MPEChannel mpe;  // a member channel for each sounding note
+
+  // Which voice each MIDI channel's note is on, and back, so expression on
+  // a channel reaches its voice without a search. Index 0 is unused.
+  int channelVoice[17];
+  int voiceChannel[numVoices];
+
+  // The last expression on each channel, which a note starting there takes
+  struct ChannelExpression {
+    float bend = 0;  // semitones
+    float pressure = -1;  // none yet
+    float timbre = 0;
+  };
+  ChannelExpression channelExpression[17];
   float frequency;
   AudioMixer4 submixers[numSubmixers];
   AudioMixer4 mixers[numMixers];
@@ -37,12 +72,103 @@ private:
   AudioEffectGranular granular;
 
   int16_t granularMemory[GRANULAR_MEMORY_SIZE];
+  int16_t stringMemory[VoicePolicy::string ? numVoices * STRING_MEMORY_PER_VOICE : 1];
+  DelayLinePool stringPool;
+
+  int16_t wavetableMemory[VoicePolicy::wavetable ? WAVETABLE_CACHE_SLOTS * WAVETABLE_PACKED_LEVELS * 257 : 1];
+  PackedWavetables flashWavetables{ waveformPacked[0], sizeof(waveformPacked) / sizeof(waveformPacked[0]), WAVETABLE_PACKED_LEVELS };
+  WavetableCache wavetables;
+  int startWavetable = -1;  // library tables, -1 for none
+  int endWavetable = -1;
+  int scanFirst = 0;  // the tables the scan rows spread across
+  int scanTables = 0;  // 0 for the whole library
+  float scanPosition = -1;  // -1 while morphing between start and end
+  WavetableIndex wavetableIndex;
+  const int16_t *scanRows[128];
+  // What the voices are reading: scanRows, or the start and end tables
+  bool scanning = false;
+  const int16_t *playingStart = NULL;
+  const int16_t *playingEnd = NULL;
+
+  // Wavetable parameters run 0..127 whatever the library holds, spread
+  // evenly across its tables
+  int libraryTable(int value) {
+    return value < 0 ? -1 : value * wavetables.count() / 128;
+  }
+  // Likewise the scan rows across the scan window
+  int scanTable(int row) {
+    int count = scanTables > 0 ? scanTables : wavetables.count();
+    return scanFirst + row * count / 128;
+  }
+
+  // A table from the cache. A miss unpacks over the least recently used
+  // slot while the audio may still be reading it, so the voices are moved
+  // off that slot first.
+  const int16_t *loadTable(int table) {
+    const int16_t *slot = wavetables.victim(table);
+    if (slot) {
+      if (scanning && !pointScanRows(slot)) {
+        scanning = false;
+        for (int i = 0; i < numVoices; i++) voices[i].wavetable.scanWaveforms(NULL, 0);
+      }
+      if (playingStart == slot) playingStart = NULL;
+      if (playingEnd == slot) playingEnd = NULL;
+      for (int i = 0; i < numVoices; i++) {
+        voices[i].wavetable.startWaveform(playingStart);
+        voices[i].wavetable.endWaveform(playingEnd);
+      }
+    }
+    return wavetables.load(table);
+  }
+
+  // Points each scan row at an unpacked table, leaving out `evicted`. Rows
+  // that are not unpacked borrow the nearest one that is, so a ramp to a
+  // far position blends straight there. False, changing nothing, if no row
+  // is unpacked.
+  bool pointScanRows(const int16_t *evicted) {
+    const int16_t *unpacked[128];
+    int below[128];
+    int last = -1;
+    for (int i = 0; i < 128; i++) {
+      unpacked[i] = wavetables.find(scanTable(i));
+      if (unpacked[i] == evicted) unpacked[i] = NULL;
+      if (unpacked[i]) last = i;
+      below[i] = last;
+    }
+    if (last < 0) return false;
+    // the voices may be scanning, so every row is only ever repointed from
+    // one unpacked table to another
+    int above = -1;
+    for (int i = 127; i >= 0; i--) {
+      if (unpacked[i]) above = i;
+      int nearest = below[i];
+      if (nearest < 0 || (above >= 0 && above - i < i - nearest)) nearest = above;
+      scanRows[i] = unpacked[nearest];
+    }
+    return true;
+  }
+
+  // Start and end tables from the cache. Both are loaded every time, so one
+  // that scanning pushed out comes back.
+  void loadWavetables() {
+    loadTable(startWavetable);
+    const int16_t *end = loadTable(endWavetable);
+    // found again, in case loading the end table pushed it out
+    const int16_t *start = wavetables.find(startWavetable);
+    playingStart = start;
+    playingEnd = end;
+    scanning = false;
+    for (int i = 0; i < numVoices; i++) {
+      voices[i].wavetable.scanWaveforms(NULL, 0);
+      voices[i].wavetable.startWaveform(start);
+      voices[i].wavetable.endWaveform(end);
+    }
+  }
 
   float bendAmount = 0;      
   float maxPitchBend = 2.0;  // Max pitch bend amount in semitones
+  float mpePitchBendRange = 48;  // semitones, the MPE default for member channels
   float detuneFactor = 0;
-  float pitchBendMultiplier = 1;
-  int mostRecentVoice = 0;
 
   AudioOutputI2S output;
 
@@ -64,7 +190,26 @@ public:
   Synth() {
     for (int i = 0; i < numVoices; i++) {
       voiceNote[i] = -1;  // Indicate that the voice is not playing any note
+      voiceChannel[i] = -1;
+    }
+    for (int c = 0; c <= 16; c++) {
+      channelVoice[c] = -1;
+    }
+    stringPool.begin(stringMemory, sizeof(stringMemory) / sizeof(stringMemory[0]));
+    strings.begin(&stringPool);
+    wavetables.begin(&flashWavetables, wavetableMemory, sizeof(wavetableMemory) / sizeof(wavetableMemory[0]));
+    wavetableIndex.begin(wavetableFeatures, wavetablesByCentroid, sizeof(wavetableFeatures) / sizeof(wavetableFeatures[0]));
+    for (int i = 0; i < numVoices; i++) {
+      voices[i].connectString(strings, i);
+      voices[i].connectModulation(modulation, i);
+      voices[i].wavetable.mipmapLevels(WAVETABLE_PACKED_LEVELS);
     }
+    // what the voices' audio-rate LFOs used to play
+    modulation.filterLfo().begin(WAVEFORM_TRIANGLE);
+    modulation.filterLfo().frequency(10);
+    modulation.vibratoLfo().begin(WAVEFORM_TRIANGLE);
+    modulation.vibratoLfo().frequency(2);
+    modulation.vibratoDepth(0);
   }
 
   struct MacroControl {
@@ -93,7 +238,7 @@ public:
 
     // Connect voices to the first level mixers
     for (int i = 0; i < numVoices; i++) {
-      new AudioConnection(voices[i].voiceEnvelope, 0, submixers[i / channelsPerMixer], i % channelsPerMixer);
+      voices[i].connectOutput(submixers[i / channelsPerMixer], i % channelsPerMixer);
       submixers[i / channelsPerMixer].gain(i % channelsPerMixer, PER_CHANNEL_GAIN);
     }
 
@@ -131,63 +276,170 @@ public:
   }
 
   void noteOn(int noteNumber, int velocity) {
-    int voiceIndex = findOldestVoice();
-    mostRecentVoice = voiceIndex;
-    voiceNote[voiceIndex] = noteNumber;
-    if (voiceIndex != -1) {
-      voices[voiceIndex].noteOn(midiNoteToFrequency[noteNumber] * pitchBendMultiplier, velocity);
+    startNote(0, noteNumber, velocity);
+  }
+
+  // A note on a MIDI channel. In a member channel of an MPE zone the note
+  // owns the channel and takes its expression; anywhere else it is given a
+  // channel of its own, as noteOn(noteNumber, velocity) does.
+  void noteOn(int channel, int noteNumber, int velocity) {
+    if (mpe.zoneOf(channel) < 0) {
+      noteOn(noteNumber, velocity);
+    } else {
+      startNote(channel, noteNumber, velocity);
     }
   }
 
   void noteOff(int noteNumber) {
+    mpe.releaseChannel(noteNumber);
     for (int i = 0; i < numVoices; i++) {
       if (voiceNote[i] == noteNumber) {
         voices[i].noteOff();
         voiceNote[i] = -1;
-        if (i == mostRecentVoice) {
-          mostRecentVoice = -1;
-        }
+        bindChannel(-1, i);
       }
     }
   }
 
+  void noteOff(int channel, int noteNumber) {
+    int voice = mpe.zoneOf(channel) < 0 ? -1 : channelVoice[channel];
+    if (voice < 0 || voiceNote[voice] != noteNumber) {
+      noteOff(noteNumber);
+      return;
+    }
+    voices[voice].noteOff();
+    voiceNote[voice] = -1;
+    bindChannel(-1, voice);
+  }
+
+  // Polyphonic aftertouch, 0 to 127, as pressure on each voice playing the
+  // note, whatever channel it came in on
   void noteAftertouch(int noteNumber, float aftertouchReading) {
-    // Convert aftertouchReading from a range (e.g., 0.0 to 1.0) to a desired volume range.
-    // This conversion depends on how aftertouch readings are scaled and the range you want.
-    // Assuming aftertouchReading is already normalized between 0.0 and 1.0,
-    // and you want to scale it to a volume range, for example, 0.5 (soft) to 1.0 (loud).
-    float volume = aftertouchReading / 127;  // Adjust the formula as needed.
-    // setDelayTime(aftertouchReading);
-    // setDetune(aftertouchReading);
-    // Iterate over the voices to find the voice(s) playing the given noteNumber.
+    float pressure = aftertouchReading / 127;
     for (int i = 0; i < numVoices; i++) {
-      if (voiceNote[i] == noteNumber) {
-        // Assuming your Voice class has a setVolume method to adjust its volume.
-        // voices[i].voiceFilter.frequency(frequency * (1 + (3 - (3 /aftertouchReading)) ));
-        // voices[i].stringAmplitude.gain(volume);
-        voices[i].wavetableMorph(volume);
-        // // voices[i].voiceEnvelope.sustain(volume);
-        // voices[i].filterEnvelope.sustain(volume);
-      }
+      if (voiceNote[i] == noteNumber) modulation.pressure(i, pressure);
     }
   }
 
+  // Expression on a channel. On a member channel it is the note's own,
+  // glided to once a block by the modulation bank; on a manager channel, or
+  // one outside both zones, it is for every note. Bend is -8192 to 8191,
+  // pressure and timbre (CC 74) 0 to 127.
+  void channelPitchBend(int channel, float value) {
+    if (mpe.zoneOf(channel) < 0) {
+      pitchBend(value);
+      return;
+    }
+    float semitones = value * mpePitchBendRange / 8192;
+    channelExpression[channel].bend = semitones;
+    if (channelVoice[channel] >= 0) modulation.pitchBend(channelVoice[channel], semitones);
+  }
+  void channelPressure(int channel, float value) {
+    float pressure = value / 127;
+    if (mpe.zoneOf(channel) < 0) {
+      for (int i = 0; i < numVoices; i++) modulation.pressure(i, pressure);
+      return;
+    }
+    channelExpression[channel].pressure = pressure;
+    if (channelVoice[channel] >= 0) modulation.pressure(channelVoice[channel], pressure);
+  }
+  void channelTimbre(int channel, float value) {
+    float timbre = (value - 64) / 64;
+    if (mpe.zoneOf(channel) < 0) {
+      for (int i = 0; i < numVoices; i++) modulation.timbre(i, timbre);
+      return;
+    }
+    channelExpression[channel].timbre = timbre;
+    if (channelVoice[channel] >= 0) modulation.timbre(channelVoice[channel], timbre);
+  }
+
+  // RPN 0 on a member channel: the range of per note pitch bend
+  void setMPEPitchBendRange(float semitones) {
+    mpePitchBendRange = semitones;
+  }
+  // Time per note expression takes to follow a new value
+  void setExpressionGlide(float milliseconds) {
+    modulation.expressionGlide(milliseconds);
+  }
+
   void setOscBlend(float value) {
     float gain = value / 127;
     for (int i = 0; i < numVoices; i++) {
-      voices[i].voiceMixer.gain(STRING, 1 - gain);
-      voices[i].voiceMixer.gain(WAVETABLE, gain * 0.4);
+      voices[i].mixGain(STRING, 1 - gain);
+      voices[i].mixGain(WAVETABLE, gain * 0.4);
+    }
+  }
+
+  // An MPE Configuration Message, from RPN 6 on channel 1 (the lower zone)
+  // or 16 (the upper zone): how many member channels the zone has
+  void setMPEZone(int managerChannel, int memberChannels) {
+    mpe.configure(managerChannel, memberChannels);
+    for (int i = 0; i < numVoices; i++) {
+      bindChannel(-1, i);
     }
+    for (int c = 0; c <= 16; c++) {
+      channelExpression[c] = ChannelExpression();
+    }
+  }
+  // The allocator's channel for a note started without one, or -1
+  int noteChannel(int noteNumber) {
+    return mpe.getChannelAssignment(noteNumber);
   }
 
   void setMaxPitchBend(float semitones) {
     maxPitchBend = semitones;
   }
 
+  // Delay line samples held by the strings right now, and at most so far
+  uint32_t stringMemoryUsage() {
+    return stringPool.used();
+  }
+  uint32_t stringMemoryUsageMax() {
+    return stringPool.usedMax();
+  }
+
   void setVolume(float value) {
     globalVolume.gain(value / 127);
   }
 
+  // channel 0 gives the note one from the allocator, which only
+  // noteChannel() reports: expression on that channel is not the note's
+  void startNote(int channel, int noteNumber, int velocity) {
+    // Strings ring until their voice envelope has finished, then hand their
+    // delay lines back so the new note can use the memory
+    for (int i = 0; i < numVoices; i++) {
+      if (!voices[i].isActive()) {
+        voices[i].string.noteOff(0);
+      }
+    }
+    int voiceIndex = findOldestVoice();
+    int stolen = voiceNote[voiceIndex];
+    if (stolen != -1 && voiceChannel[voiceIndex] < 0) {
+      mpe.releaseChannel(stolen);  // the stolen note stops
+    }
+    if (channel == 0) mpe.assignChannel(noteNumber);
+    voiceNote[voiceIndex] = noteNumber;
+    bindChannel(channel, voiceIndex);
+    if (channel > 0) {
+      const ChannelExpression &e = channelExpression[channel];
+      modulation.expression(voiceIndex, e.bend, e.pressure, e.timbre);
+    } else {
+      modulation.expression(voiceIndex, 0, -1, 0);
+    }
+    voices[voiceIndex].noteOn(midiNoteToFrequency[noteNumber], velocity);
+  }
+
+  // Puts voice on channel, taking each off whatever it was on; -1 for no
+  // channel
+  void bindChannel(int channel, int voice) {
+    if (voiceChannel[voice] >= 0) channelVoice[voiceChannel[voice]] = -1;
+    if (channel > 0) {
+      if (channelVoice[channel] >= 0) voiceChannel[channelVoice[channel]] = -1;
+      channelVoice[channel] = voice;
+    }
+    voiceChannel[voice] = channel > 0 ? channel : -1;
+  }
+
   int findOldestVoice() {
     int oldestVoiceIndex = -1;
     unsigned long oldestTimestamp = ULONG_MAX;
@@ -226,6 +478,11 @@ public:
     Serial.println("Creating a random patch");
     for (auto& param : parameters) {
       float randomValue = weightedRandom(0, 127, param.preferredValue, param.weighting);
+      // End on a timbre close to the start, so the morph stays musical.
+      // The index describes the tables in flash, so not with a library.
+      if (param.name == "End Wavetable" && startWavetable >= 0 && wavetables.library() == &flashWavetables) {
+        randomValue = wavetableIndex.pickSimilar(startWavetable);
+      }
       param.setterFunction(randomValue);
       param.currentValue = randomValue;
     }
@@ -286,23 +543,37 @@ public:
     }
   }
 
+  //String Controls
+  void setStringDecay(float value) {
+    float seconds = 0.2 + pow(value / 127, 2) * 19.8;  // 0.2 to 20 s
+    for (int i = 0; i < numVoices; i++) {
+      voices[i].string.decay(seconds);
+    }
+  }
+  void setStringBrightness(float value) {
+    float level = value / 127;
+    for (int i = 0; i < numVoices; i++) {
+      voices[i].string.brightness(level);
+    }
+  }
+
   //FM Controls
   void setStringFm(float value) {
     float gain = value * 0.001;
     for (int i = 0; i < numVoices; i++) {
-      voices[i].fmModulator.gain(STRING, gain);
+      voices[i].fmGain(STRING, gain);
     }
   }
   void setSineFm(float value) {
     float gain = value * 0.001;
     for (int i = 0; i < numVoices; i++) {
-      voices[i].fmModulator.gain(SINE, gain);
+      voices[i].fmGain(SINE, gain);
     }
   }
   void setWavetableFm(float value) {
     float gain = value * 0.001;
     for (int i = 0; i < numVoices; i++) {
-      voices[i].fmModulator.gain(WAVETABLE, gain);
+      voices[i].fmGain(WAVETABLE, gain);
     }
   }
   void setOctaveControl(float value) {
@@ -340,33 +611,23 @@ public:
   //LFO DADSR
   void setLfoDelay(float value) {
     int delay = pow(value, 1.7);
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].lfo2Envelope.delay(delay);
-    }
+    modulation.delay(delay);
   }
   void setLfoAttack(float value) {
     int attack = pow(value, 1.7);
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].lfo2Envelope.attack(attack);
-    }
+    modulation.attack(attack);
   }
   void setLfoDecay(float value) {
     float decay = pow(value, 1.7);
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].lfo2Envelope.decay(decay);
-    }
+    modulation.decay(decay);
   }
   void setLfoSustain(float value) {
     float sustain = value / 127;
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].lfo2Envelope.sustain(sustain);
-    }
+    modulation.sustain(sustain);
   }
   void setLfoRelease(float value) {
     float release = pow(value, 1.7);
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].lfo2Envelope.release(release);
-    }
+    modulation.release(release);
   }
 
   //Filter Controls
@@ -378,7 +639,7 @@ public:
     frequency = minFreq * pow((maxFreq / minFreq), (value / 127.0));
 
     for (int i = 0; i < numVoices; i++) {
-      voices[i].voiceFilter.frequency(frequency);
+      voices[i].setFilterFrequency(frequency);
     }
   }
   void setFilterResonance(float value) {
@@ -395,23 +656,16 @@ public:
   }
   void setFilterEnvelope(float value) {
     float amount = (value / 64) - 1;
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].filterAmount.amplitude(amount);
-    }
+    modulation.envelopeAmount(amount);
   }
   void setFilterModBlend(float value) {
     float blend = value / 127;
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].filterModBlend.gain(0, blend);
-      voices[i].filterModBlend.gain(1, 1 - blend);
-    }
+    modulation.blend(blend);
   }
 
   //Modulation
   void setLfoAmount(float value) {
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].lfo2.amplitude(value / 127);
-    }
+    modulation.filterLfo().amplitude(value / 127);
   }
   void setLfoRate(float value) {
     // Convert MIDI value (0-127) to a useful LFO rate using exponential scaling
@@ -420,43 +674,100 @@ public:
     float exponent = (value / 127.0f) * 3.0f;           // Exponentially scale value over 3 octaves
     float lfoRateHz = minLfoHz * powf(2.0f, exponent);  // Calculate LFO frequency
 
-    for (int i = 0; i < numVoices; i++) {
-      voices[i].lfo2.frequency(lfoRateHz);
-    }
+    modulation.filterLfo().frequency(lfoRateHz);
   }
   void setVibrato(float value) {
-
     float rate = (value / 35) + 2;  // Map to a reasonable rate range
-    float depth = value / 70;       // Map to a reasonable depth range
+    float depth = value / 2100;     // Up to 6% either way, 0 is off
 
-    // Set the vibrato parameters
-
-
-    for (int i = 0; i < numVoices; i++) {
-      if (value == 0) {
-        voices[i].vibratoOff();
-      } else {
-        voices[i].lfo.frequency(rate);   // Set the vibrato rate
-        voices[i].lfo.amplitude(depth);  // Set the vibrato depth
-        voices[i].updateVibrato();
-      }
-    }
+    modulation.vibratoLfo().frequency(rate);
+    modulation.vibratoDepth(depth);
   }
 
   //Oscillators
   void setStartWavetable(float value) {
-    int selector = value;
+    setStartTable(libraryTable(value));
+  }
+  void setEndWavetable(float value) {
+    setEndTable(libraryTable(value));
+  }
+  // The same by library table, for libraries of more than 128 tables,
+  // where the parameters reach only every so many
+  void setStartTable(int table) {
+    startWavetable = table;
+    scanPosition = -1;
+    loadWavetables();
+  }
+  void setEndTable(int table) {
+    endWavetable = table;
+    scanPosition = -1;
+    loadWavetables();
+  }
+  // Scans 128 rows spread across the scan window, 0..127 with fractions
+  // blending neighbours. Setting the start or end wavetable goes back to
+  // morphing between those.
+  void setWavetablePosition(float value) {
+    scanPosition = value;
+    int row = constrain((int)value, 0, 126);
+    loadTable(scanTable(row));
+    loadTable(scanTable(row + 1));
+    if (!pointScanRows(NULL)) return;
+    scanning = true;
     for (int i = 0; i < numVoices; i++) {
-      voices[i].oscillatorOne.arbitraryWaveform(waveform[selector], 800);
-      voices[i].oscillatorThree.arbitraryWaveform(waveform[selector], 800);
+      voices[i].wavetable.scanWaveforms(scanRows, 128);
+      voices[i].wavetable.position(value);
     }
   }
-  void setEndWavetable(float value) {
-    int selector = value;
+  // The tables the scan rows spread across, count from first, so every
+  // table of a large library can be scanned a window at a time. A count of
+  // 0 spreads them across the whole library again.
+  void setScanTables(int first, int count) {
+    int total = wavetables.count();
+    scanFirst = constrain(first, 0, total > 0 ? total - 1 : 0);
+    scanTables = constrain(count, 0, total - scanFirst);
+    if (scanPosition >= 0) setWavetablePosition(scanPosition);
+  }
+  // Plays tables from a library, such as a WavetableFile on the SD card,
+  // in place of those in flash; NULL goes back to flash. The library has to
+  // stay open while it is in use. Call from loop(), as the tables in use are
+  // read again straight away. The start and end tables keep their place in
+  // the library, scaled to its size, and scanning spreads across all of it.
+  void useWavetableLibrary(WavetableSource *library) {
+    if (!library || library->count() < 1) library = &flashWavetables;
+    int oldCount = wavetables.count();
+    // nothing plays from the cache while it is emptied
     for (int i = 0; i < numVoices; i++) {
-      voices[i].oscillatorTwo.arbitraryWaveform(waveform[selector], 800);
-      voices[i].oscillatorFour.arbitraryWaveform(waveform[selector], 800);
+      voices[i].wavetable.scanWaveforms(NULL, 0);
+      voices[i].wavetable.startWaveform(NULL);
+      voices[i].wavetable.endWaveform(NULL);
+      voices[i].wavetable.mipmapLevels(library->levels());
+    }
+    scanning = false;
+    playingStart = playingEnd = NULL;
+    wavetables.begin(library, wavetableMemory, sizeof(wavetableMemory) / sizeof(wavetableMemory[0]));
+    if (oldCount > 0) {
+      if (startWavetable >= 0) startWavetable = (int64_t)startWavetable * library->count() / oldCount;
+      if (endWavetable >= 0) endWavetable = (int64_t)endWavetable * library->count() / oldCount;
     }
+    scanFirst = 0;
+    scanTables = 0;
+    if (scanPosition >= 0) {
+      setWavetablePosition(scanPosition);
+    } else {
+      loadWavetables();
+    }
+  }
+  uint32_t wavetableUnpacks() {
+    return wavetables.misses();
+  }
+  // Spectral features of the tables in flash, for picking tables by
+  // brightness or likeness
+  const WavetableIndex &wavetableFeatureIndex() const {
+    return wavetableIndex;
+  }
+  // Slowest table read so far, from flash or the library
+  uint32_t wavetableLoadMicros() {
+    return wavetables.maxLoadMicros();
   }
   void setDetuneAmount(float detune) {
     for (int i = 0; i < numVoices; i++) {
@@ -493,9 +804,9 @@ public:
 
     // Apply the calculated gains
     for (int i = 0; i < numVoices; i++) {
-      voices[i].voiceMixer.gain(STRING, gainString);
-      voices[i].voiceMixer.gain(WAVETABLE, gainWavetable);
-      voices[i].voiceMixer.gain(SINE, gainSine);
+      voices[i].mixGain(STRING, gainString);
+      voices[i].mixGain(WAVETABLE, gainWavetable);
+      voices[i].mixGain(SINE, gainSine);
     }
     //   // Use normalizedValue directly to distribute gain across the three sources
     //   float normalizedValue = value / 127.0;
@@ -517,23 +828,8 @@ public:
 
   //Pitch
   void pitchBend(float value) {
-
     bendAmount = (maxPitchBend / 8192) * value;
-    pitchBendMultiplier = pow(2.0, bendAmount / 12);
-
-    Serial.println(pitchBendMultiplier);
-    // Apply pitch bend to most recent voice
-    if (mostRecentVoice > -1) {
-      voices[mostRecentVoice].applyPitchBend(pitchBendMultiplier);
-    }
-
-    // // Apply pitch bend to each voice
-    // for (int i = 0; i < numVoices; i++) {
-    //   if (voices[i].isSustain) {
-    //     // Update the frequency for relevant components in the voice
-    //     voices[mostRecentVoice].applyPitchBend(bentFrequency);
-    //   }
-    // }
+    modulation.masterBend(bendAmount);
   }
   void setDetune(float value) {
     // Assuming value is in the range [0, 127]
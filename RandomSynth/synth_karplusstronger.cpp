@@ -1,66 +1,244 @@
 #include <Arduino.h>
 #include "synth_karplusstronger.h"
 
-#if defined(KINETISK) || defined(__IMXRT1062__)
-static uint32_t pseudorand(uint32_t lo)
+#if defined(KINETISK) || defined(__IMXRT1062__) || defined(RANDOMSYNTH_HOST)
+// Marsaglia xorshift32: three shifts and xors per sample, no multiply
+static inline uint32_t xorshift32(uint32_t x)
 {
-	uint32_t hi;
-
-	hi = multiply_16bx16t(16807, lo); // 16807 * (lo >> 16)
-	lo = 16807 * (lo & 0xFFFF);
-	lo += (hi & 0x7FFF) << 16;
-	lo += hi >> 15;
-	lo = (lo & 0x7FFFFFFF) + (lo >> 31);
-	return lo;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+// (x * c) >> 15, rounded towards zero rather than down. Rounding down would
+// feed a small negative bias round the loop, and the string would settle on
+// a DC offset instead of dying away.
+static inline int32_t multiply_q15_towards_zero(int32_t x, int32_t c)
+{
+	int32_t product = x * c;
+	return (product + ((product >> 31) & 0x7FFF)) >> 15;
+}
+
+// One trip around the loop. The two point lowpass x[n] + d * (x[n-1] - x[n])
+// delays by d samples, d = 0.5 being the classic average, then the Q30 gain
+// for one trip sets the decay time. The first order allpass covers the
+// fractional part of the period, y[n] = c * (x[n] - y[n-1]) + x[n-1].
+static inline int16_t stringSample(int16_t in, int16_t &prior, int32_t &apIn, int32_t &apOut,
+	int32_t coef, int32_t damping, int32_t gain)
+{
+	int32_t lowpass = in + multiply_q15_towards_zero(prior - in, damping);
+	int64_t scaled = (int64_t)lowpass * gain;
+	lowpass = (scaled + ((scaled >> 63) & 0x3FFFFFFF)) >> 30;
+	prior = in;
+	// rounded to nearest: exact halves, the only biased case, are rare with
+	// an arbitrary coefficient, and this is the sample to sample feedback
+	// path so it is kept short
+	int32_t out = saturate16((coef * (lowpass - apOut) + (apIn << 15) + 0x4000) >> 15);
+	apIn = lowpass;
+	apOut = out;
+	return out;
 }
 #endif
 
 
-void AudioSynthKarplusStronger::update(void)
+void AudioSynthKarplusStrongStrings::begin(DelayLinePool *pool)
+{
+	for (int i=0; i < stringCount; i++) {
+		noteOff(i, 0);
+		damping[i] = 16384;
+		decay(i, DEFAULT_DECAY);
+	}
+	this->pool = pool;
+}
+
+void AudioSynthKarplusStrongStrings::noteOn(int string, float frequency, float velocity)
+{
+	if (velocity > 1.0f) {
+		velocity = 0.0f;
+	} else if (velocity <= 0.0f) {
+		noteOff(string, 1.0f);
+		return;
+	}
+
+	// Leave room below the note for pitch bend and vibrato
+	float len = AUDIO_SAMPLE_RATE_EXACT / frequency * PITCH_HEADROOM;
+	if (len < 2) len = 2;
+	else if (len > MAX_BUFFER_LEN) len = MAX_BUFFER_LEN;
+
+	// Give back the previous note's line before asking for one that fits
+	noteOff(string, 0);
+	if (!pool) return;
+	int16_t *line = pool->allocate(len);
+	if (!line) return;
+
+	__disable_irq();
+	control[string].magnitude = velocity * 65535.0f;
+	control[string].quiet = 0;
+	buffer[string] = line;
+	bufferSize[string] = len;
+	control[string].targetPeriod = AUDIO_SAMPLE_RATE_EXACT / frequency;
+	setPeriod(string, control[string].targetPeriod);
+	bufferIndex[string] = 0;
+	excitation[string] = 0;
+	lastInput[string] = 0;
+	allpassIn[string] = 0;
+	allpassOut[string] = 0;
+	state[string] = 1;
+	__enable_irq();
+}
+
+void AudioSynthKarplusStrongStrings::noteOff(int string, float)
 {
-#if defined(KINETISK) || defined(__IMXRT1062__)
+	__disable_irq();
+	state[string] = 0;
+	int16_t *line = buffer[string];
+	buffer[string] = NULL;
+	__enable_irq();
+	if (line) pool->release(line, bufferSize[string]);
+}
+
+void AudioSynthKarplusStrongStrings::decay(int string, float seconds)
+{
+	// Natural log of the gain per sample for a 60 dB fall in that time
+	__disable_irq();
+	control[string].decayRate = seconds > 0 ? -6.9078f / (seconds * AUDIO_SAMPLE_RATE_EXACT) : 0;
+	if (buffer[string]) setPeriod(string, control[string].period);
+	__enable_irq();
+}
+
+void AudioSynthKarplusStrongStrings::brightness(int string, float level)
+{
+	if (level < 0) level = 0;
+	else if (level > 1.0f) level = 1.0f;
+	__disable_irq();
+	damping[string] = 16384 - level * 14746;  // 0.5 down to 0.05
+	// the lowpass delay has changed, so retune
+	if (buffer[string]) setPeriod(string, control[string].period);
+	__enable_irq();
+}
+
+// Splits the loop period into the whole samples of the delay line plus the
+// lowpass delay and a 0.5..1.5 sample allpass, which keeps the allpass
+// coefficient small and the loop stable.
+void AudioSynthKarplusStrongStrings::setPeriod(int string, float samples)
+{
+	float lowpassDelay = damping[string] * (1.0f / 32768.0f);
+	float len = samples - lowpassDelay - 0.5f;
+	if (len < 2) len = 2;
+	else if (len > bufferSize[string]) len = bufferSize[string];
+	uint16_t whole = len;
+	float fraction = samples - lowpassDelay - whole;
+	if (fraction < 0.5f) fraction = 0.5f;
+	else if (fraction > 1.5f) fraction = 1.5f;
+	control[string].period = samples;
+	// each sample passes the loop gain once per period
+	loopGain[string] = expf(control[string].decayRate * samples) * 1073741824.0f;
+	bufferLen[string] = whole;
+	allpassCoef[string] = 32768.0f * (1.0f - fraction) / (1.0f + fraction);
+	if (bufferIndex[string] >= whole) bufferIndex[string] = 0;
+}
+
+void AudioSynthKarplusStrongStrings::update(void)
+{
+#if defined(KINETISK) || defined(__IMXRT1062__) || defined(RANDOMSYNTH_HOST)
 	audio_block_t *block;
 
-	if (state == 0) return;
+	for (int i=0; i < stringCount; i++) {
+		if (state[i] == 0 || (state[i] & MUTED)) continue;
 
-	if (state == 1) {
-		uint32_t lo = seed;
-		for (int i=0; i < bufferLen; i++) {
-			lo = pseudorand(lo);
-			buffer[i] = signed_multiply_32x16b(magnitude, lo);
+		Control &c = control[i];
+		if (c.period != c.targetPeriod) {
+			float step = (c.targetPeriod - c.period) * c.glideRate;
+			if (step > -0.001f && step < 0.001f) {
+				setPeriod(i, c.targetPeriod);
+			} else {
+				setPeriod(i, c.period + step);
+			}
 		}
-		seed = lo;
-		state = 2;
-	}
 
-	block = allocate();
-	if (!block) {
-		state = 0;
-		return;
+		if (state[i] == 1) {
+			// The line is not filled here: its first trip around the loop
+			// reads noise instead, so many notes starting in one block cost
+			// no more than notes already ringing.
+			excitation[i] = bufferLen[i];
+			state[i] = 2;
+		}
+
+		block = allocate();
+		if (!block) {
+			state[i] = 0;
+			continue;
+		}
+		render(i, block->data);
+		transmit(block, i);
+		release(block);
 	}
+#endif
+}
 
-	int16_t prior;
-	if (bufferIndex > 0) {
-		prior = buffer[bufferIndex - 1];
-	} else {
-		prior = buffer[bufferLen - 1];
+void AudioSynthKarplusStrongStrings::render(int string, int16_t *data)
+{
+#if defined(KINETISK) || defined(__IMXRT1062__) || defined(RANDOMSYNTH_HOST)
+	int16_t *line = buffer[string];
+	uint32_t len = bufferLen[string];
+	uint32_t index = bufferIndex[string];
+	uint32_t excite = excitation[string];
+	int16_t prior = lastInput[string];
+	int32_t coef = allpassCoef[string];
+	int32_t apIn = allpassIn[string];
+	int32_t apOut = allpassOut[string];
+	int32_t damp = damping[string];
+	int32_t gain = loopGain[string];
+	uint32_t level = 0;
+	uint32_t remaining = AUDIO_BLOCK_SAMPLES;
+	while (remaining > 0) {
+		// run to the end of the delay line, so the loop needs no wrap check
+		uint32_t run = len - index;
+		if (run > remaining) run = remaining;
+		int16_t *p = line + index;
+		index += run;
+		if (index >= len) index = 0;
+		remaining -= run;
+		if (excite) {
+			uint32_t n = run < excite ? run : excite;
+			uint32_t x = seed;
+			int32_t magnitude = control[string].magnitude;
+			excite -= n;
+			run -= n;
+			while (n--) {
+				x = xorshift32(x);
+				int16_t out = stringSample(signed_multiply_32x16b(magnitude, x), prior, apIn, apOut, coef, damp, gain);
+				// counted too, or a block that is all excitation would
+				// look silent once the excitation has run out
+				level |= out ^ (out >> 15);
+				*p++ = out;
+				*data++ = out;
+			}
+			seed = x;
+		}
+		while (run--) {
+			int16_t out = stringSample(*p, prior, apIn, apOut, coef, damp, gain);
+			level |= out ^ (out >> 15);  // |out|, one less when negative
+			*p++ = out;
+			*data++ = out;
+		}
 	}
-	int16_t *data = block->data;
-	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
-		int16_t in = buffer[bufferIndex];
-		//int16_t out = (in * 32604 + prior * 32604) >> 16;
-		// int16_t out = (in * 32686 + prior * 32686) >> 16;
-		int16_t out = (in * 32768 + prior * 32768) >> 16;
-		*data++ = out;
-		buffer[bufferIndex] = out;
-		prior = in;
-		if (++bufferIndex >= bufferLen) bufferIndex = 0;
+	bufferIndex[string] = index;
+	excitation[string] = excite;
+	// every sample in the line was written by the render, so once the quiet
+	// run covers the line the whole period is silent
+	if (excite || level > SILENCE) {
+		control[string].quiet = 0;
+	} else {
+		control[string].quiet += AUDIO_BLOCK_SAMPLES;
+		if (control[string].quiet >= len) state[string] = 0;
 	}
-
-	transmit(block);
-	release(block);
+	lastInput[string] = prior;
+	allpassIn[string] = apIn;
+	allpassOut[string] = apOut;
 #endif
 }
 
 
-uint32_t AudioSynthKarplusStronger::seed = 1;
\ No newline at end of file
+uint32_t AudioSynthKarplusStrongStrings::seed = 1;
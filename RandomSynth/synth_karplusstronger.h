@@ -5,54 +5,233 @@
 #include "Arduino.h"
 #include "AudioStream.h"
 #include "utility/dspinst.h"
+#include "delay_line_pool.h"
 
-class AudioSynthKarplusStronger : public AudioStream {
+// Any number of Karplus-Strong strings rendered by one update(), string i on
+// output i. Per string state lives in parallel arrays supplied by
+// AudioSynthKarplusStrongBank<N>, so the render loop walks contiguous memory
+// and idle strings cost one test each.
+class AudioSynthKarplusStrongStrings : public AudioStream {
 public:
-  AudioSynthKarplusStronger() : AudioStream(1, inputQueueArray) {  // Adjusted for 2 inputs
-    state = 0;
-  }
-
   virtual void update(void);
 
-  void noteOn(float frequency, float velocity) {
-    if (velocity > 1.0f) {
-      velocity = 0.0f;
-    } else if (velocity <= 0.0f) {
-      noteOff(1.0f);
-      return;
+  // Delay lines come from this pool, sized for each note. Without a pool the
+  // strings stay silent.
+  void begin(DelayLinePool *pool);
+
+  void noteOn(int string, float frequency, float velocity);
+  void noteOff(int string, float velocity);
+  // Stops the string rendering at once. Unlike noteOff() it can be called
+  // from another object's update, as it keeps the delay line until the
+  // next noteOn() or noteOff(), and resume() carries on from where it
+  // stopped.
+  void mute(int string) {
+    if (state[string]) state[string] |= MUTED;
+  }
+  void resume(int string) {
+    state[string] &= ~MUTED;
+  }
+
+  // Retunes the ringing string without re-exciting it. With glide set, the
+  // pitch slides there; the line allocated at noteOn is never exceeded.
+  void setPitch(int string, float frequency) {
+    if (frequency > 0) {
+      control[string].targetPeriod = AUDIO_SAMPLE_RATE_EXACT / frequency;
     }
+  }
 
-    baseFrequency = frequency;
-    magnitude = velocity * 65535.0f;
-    float len = AUDIO_SAMPLE_RATE_EXACT / frequency;
-    bufferLen = len;
-    bufferIndex = 0;
-    state = 1;
+  // Time for a pitch change to get about two thirds of the way, 0 to jump
+  void glide(int string, float milliseconds) {
+    float blocks = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f) / AUDIO_BLOCK_SAMPLES;
+    control[string].glideRate = blocks > 1.0f ? 1.0f / blocks : 1.0f;
   }
 
+  // Time for the string to fall 60 dB, on top of the loss in the lowpass.
+  // 0 leaves only the lowpass, which lets a DC offset ring forever.
+  void decay(int string, float seconds);
+
+  // 0 is the classic two point average, 1 keeps far more of the highs
+  void brightness(int string, float level);
+
+  // True while the string holds a delay line from the pool. It may have
+  // decayed to silence and stopped rendering already.
+  bool isPlaying(int string) {
+    return buffer[string] != NULL;
+  }
+
+  // True while the string renders, which a muted one does not
+  bool isSounding(int string) {
+    return state[string] != 0 && !(state[string] & MUTED);
+  }
+
+  int strings() {
+    return stringCount;
+  }
+
+  // Longest delay line a note can ask for: the lowest piano A, 27.5 Hz
+  static constexpr uint16_t MAX_BUFFER_LEN = AUDIO_SAMPLE_RATE_EXACT / 27.5f + 1;
+  // Lines are this much longer than the note, enough to bend 2 semitones down
+  static constexpr float PITCH_HEADROOM = 1.125f;
+  static constexpr float DEFAULT_DECAY = 10.0f;  // seconds, set by begin()
+  // A string stops rendering once a whole trip round its delay line stays
+  // within 1 LSB, -90 dBFS. One quiet block is not enough for a low note,
+  // whose line can hold a louder part of the period.
+  static constexpr uint32_t SILENCE = 1;
+
+protected:
+  static constexpr uint8_t MUTED = 4;  // set in state on a string that was playing
+
+  // Pitch and level, only touched at note on and once per block
+  struct Control {
+    float period = 0;        // loop length in samples, fractional
+    float targetPeriod = 0;
+    float glideRate = 1.0f;  // share of the remaining pitch change per block
+    int32_t magnitude = 0;
+    float decayRate = 0;     // ln of the extra gain per sample
+    uint32_t quiet = 0;      // samples rendered within SILENCE since the last louder one
+  };
+
+  AudioSynthKarplusStrongStrings(int stringCount, uint8_t *state, int16_t **buffer,
+                                 uint16_t *bufferSize, uint16_t *bufferLen, uint16_t *bufferIndex,
+                                 uint16_t *excitation, int16_t *lastInput, int16_t *allpassIn,
+                                 int16_t *allpassOut, int16_t *allpassCoef, int16_t *damping,
+                                 int32_t *loopGain, Control *control)
+    : AudioStream(0, NULL), stringCount(stringCount), state(state), buffer(buffer),
+      bufferSize(bufferSize), bufferLen(bufferLen), bufferIndex(bufferIndex),
+      excitation(excitation), lastInput(lastInput), allpassIn(allpassIn),
+      allpassOut(allpassOut), allpassCoef(allpassCoef), damping(damping), loopGain(loopGain),
+      control(control) {}
+
+private:
+  void setPeriod(int string, float samples);
+  void render(int string, int16_t *data);
+
+  int stringCount;
+  DelayLinePool *pool = NULL;
+  uint8_t *state;        // 0=silent, 1=excite on next update, 2=playing, | MUTED
+  int16_t **buffer;      // Q15 delay line, owned while the note plays
+  uint16_t *bufferSize;  // samples allocated from the pool for the note
+  uint16_t *bufferLen;   // whole samples of the loop period in use
+  uint16_t *bufferIndex;
+  uint16_t *excitation;  // noise samples still to feed into the loop
+  int16_t *lastInput;    // previous delay line sample, for the averaging filter
+  int16_t *allpassIn;
+  int16_t *allpassOut;
+  int16_t *allpassCoef;  // Q15 fractional delay coefficient
+  int16_t *damping;      // Q15 lowpass weight of the previous sample, 0.05..0.5
+  int32_t *loopGain;     // Q30 gain per trip round the loop
+  Control *control;
+  static uint32_t seed;  // xorshift state, never 0
+};
+
+template<int numStrings>
+class AudioSynthKarplusStrongBank : public AudioSynthKarplusStrongStrings {
+public:
+  AudioSynthKarplusStrongBank()
+    : AudioSynthKarplusStrongStrings(numStrings, stateArray, bufferArray, bufferSizeArray,
+                                     bufferLenArray, bufferIndexArray, excitationArray,
+                                     lastInputArray, allpassInArray, allpassOutArray,
+                                     allpassCoefArray, dampingArray, loopGainArray, controlArray) {}
+
+private:
+  uint8_t stateArray[numStrings] = {};
+  int16_t *bufferArray[numStrings] = {};
+  uint16_t bufferSizeArray[numStrings] = {};
+  uint16_t bufferLenArray[numStrings] = {};
+  uint16_t bufferIndexArray[numStrings] = {};
+  uint16_t excitationArray[numStrings] = {};
+  int16_t lastInputArray[numStrings] = {};
+  int16_t allpassInArray[numStrings] = {};
+  int16_t allpassOutArray[numStrings] = {};
+  int16_t allpassCoefArray[numStrings] = {};
+  int16_t dampingArray[numStrings] = {};
+  int32_t loopGainArray[numStrings] = {};
+  Control controlArray[numStrings];
+};
+
+// A single string, for sketches that want one on its own. It plays from a
+// pool of its own, big enough for the lowest note, unless begin() gives it
+// a shared one.
+class AudioSynthKarplusStronger : public AudioSynthKarplusStrongBank<1> {
+public:
+  AudioSynthKarplusStronger() {
+    ownPool.begin(ownMemory, OWN_POOL_SAMPLES);
+    begin(&ownPool);
+  }
+  void noteOn(float frequency, float velocity) {
+    AudioSynthKarplusStrongBank<1>::noteOn(0, frequency, velocity);
+  }
   void noteOff(float velocity) {
-    state = 0;
+    AudioSynthKarplusStrongBank<1>::noteOff(0, velocity);
+  }
+  void setPitch(float frequency) {
+    AudioSynthKarplusStrongBank<1>::setPitch(0, frequency);
+  }
+  void glide(float milliseconds) {
+    AudioSynthKarplusStrongBank<1>::glide(0, milliseconds);
   }
+  void decay(float seconds) {
+    AudioSynthKarplusStrongBank<1>::decay(0, seconds);
+  }
+  void brightness(float level) {
+    AudioSynthKarplusStrongBank<1>::brightness(0, level);
+  }
+  bool isPlaying() {
+    return AudioSynthKarplusStrongBank<1>::isPlaying(0);
+  }
+  bool isSounding() {
+    return AudioSynthKarplusStrongBank<1>::isSounding(0);
+  }
+
+private:
+  // the longest line, rounded up to whole pool chunks
+  static constexpr uint32_t OWN_POOL_SAMPLES =
+    (MAX_BUFFER_LEN + DELAY_LINE_CHUNK_SAMPLES - 1) / DELAY_LINE_CHUNK_SAMPLES * DELAY_LINE_CHUNK_SAMPLES;
+  DelayLinePool ownPool;
+  int16_t ownMemory[OWN_POOL_SAMPLES];
+};
 
+// One string of a bank, so a voice can play it without knowing the bank size
+class KarplusStrongString {
+public:
+  void attach(AudioSynthKarplusStrongStrings *strings, int index) {
+    this->strings = strings;
+    this->index = index;
+  }
+  void noteOn(float frequency, float velocity) {
+    if (strings) strings->noteOn(index, frequency, velocity);
+  }
+  void noteOff(float velocity) {
+    if (strings) strings->noteOff(index, velocity);
+  }
+  void mute() {
+    if (strings) strings->mute(index);
+  }
+  void resume() {
+    if (strings) strings->resume(index);
+  }
   void setPitch(float frequency) {
-    if (state == 2 && frequency > 0) {
-      // Only update pitch if the string is currently playing
-      float len = AUDIO_SAMPLE_RATE_EXACT / frequency;
-      bufferLen = len;
-    }
+    if (strings) strings->setPitch(index, frequency);
+  }
+  void glide(float milliseconds) {
+    if (strings) strings->glide(index, milliseconds);
+  }
+  void decay(float seconds) {
+    if (strings) strings->decay(index, seconds);
+  }
+  void brightness(float level) {
+    if (strings) strings->brightness(index, level);
+  }
+  bool isPlaying() {
+    return strings && strings->isPlaying(index);
+  }
+  bool isSounding() {
+    return strings && strings->isSounding(index);
   }
 
 private:
-  uint8_t state;  // 0=steady output, 1=begin on next update, 2=playing
-  uint16_t bufferLen;
-  uint16_t bufferIndex;
-  int32_t magnitude;     // current output
-  static uint32_t seed;  // must start at 1
-  float buffer[536];     // TODO: dynamically use audio memory blocks
-  audio_block_t *inputQueueArray[1];
-  float decay = 0.999999999;
-  const uint16_t MIN_BUFFER_LEN = 44100 / 27.5;
-  float baseFrequency = 0;
+  AudioSynthKarplusStrongStrings *strings = NULL;
+  int index = 0;
 };
 
 #endif
@@ -0,0 +1,170 @@
+#include <Arduino.h>
+#include "synth_modulation.h"
+
+enum {
+	STAGE_IDLE,
+	STAGE_DELAY,
+	STAGE_ATTACK,
+	STAGE_DECAY,
+	STAGE_SUSTAIN,
+	STAGE_RELEASE
+};
+
+// A well mixed 32 bit hash, so sample and hold gives every cycle its own
+// value without keeping any state per reader
+static inline uint32_t mix(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7FEB352Du;
+	x ^= x >> 15;
+	x *= 0x846CA68Bu;
+	x ^= x >> 16;
+	return x;
+}
+
+float ControlLfo::read(uint32_t offset) const
+{
+	uint32_t ph = phase + offset;
+	float value;
+	switch (shape) {
+	case WAVEFORM_TRIANGLE:
+		// from 0 rising, like AudioSynthWaveform
+		value = 1.0f - 4.0f * fabsf((ph + 0x40000000u) * (1.0f / 4294967296.0f) - 0.5f);
+		break;
+	case WAVEFORM_SAWTOOTH:
+		value = (int32_t)ph * (1.0f / 2147483648.0f);
+		break;
+	case WAVEFORM_SAWTOOTH_REVERSE:
+		value = (int32_t)ph * (-1.0f / 2147483648.0f);
+		break;
+	case WAVEFORM_SQUARE:
+		value = ph < 0x80000000u ? 1.0f : -1.0f;
+		break;
+	case WAVEFORM_SAMPLE_HOLD:
+		// the offset can carry a reader into the next cycle
+		value = (int32_t)mix(cycles + (ph < phase)) * (1.0f / 2147483648.0f);
+		break;
+	default:
+		value = sinf(ph * (TWO_PI / 4294967296.0f));
+		break;
+	}
+	return value * level;
+}
+
+void AudioSynthModulation::noteOn(int voice)
+{
+	ModulationState &s = state[voice];
+	s.count = delayBlocks;
+	s.stage = delayBlocks ? STAGE_DELAY : STAGE_ATTACK;
+}
+
+void AudioSynthModulation::expression(int voice, float semitones, float pressure, float timbre)
+{
+	ModulationState &s = state[voice];
+	s.bendTarget = semitones;
+	s.bend = semitones + masterSemitones;
+	s.bendRatio = exp2f(s.bend * (1.0f / 12.0f));
+	s.pressureTarget = s.pressure = pressure;
+	s.timbreTarget = s.timbre = timbre;
+	s.resend = true;
+}
+
+void AudioSynthModulation::noteOff(int voice)
+{
+	ModulationState &s = state[voice];
+	if (s.stage == STAGE_IDLE) return;
+	s.releaseStep = s.envelope / releaseBlocks;
+	s.stage = STAGE_RELEASE;
+}
+
+// The depth envelope one block on. Rises and falls are straight lines, and
+// attack starts from wherever the last note left it.
+float AudioSynthModulation::stepEnvelope(ModulationState &s)
+{
+	switch (s.stage) {
+	case STAGE_DELAY:
+		if (s.count > 0) {
+			s.count--;
+			break;
+		}
+		s.stage = STAGE_ATTACK;
+		// fall through
+	case STAGE_ATTACK:
+		s.envelope += attackStep;
+		if (s.envelope >= 1.0f) {
+			s.envelope = 1.0f;
+			s.stage = STAGE_DECAY;
+		}
+		break;
+	case STAGE_DECAY:
+		s.envelope -= decayStep * (1.0f - sustainLevel);
+		if (s.envelope <= sustainLevel) {
+			s.envelope = sustainLevel;
+			s.stage = STAGE_SUSTAIN;
+		}
+		break;
+	case STAGE_SUSTAIN:
+		s.envelope = sustainLevel;
+		break;
+	case STAGE_RELEASE:
+		s.envelope -= s.releaseStep;
+		if (s.envelope <= 0.0f) {
+			s.envelope = 0.0f;
+			s.stage = STAGE_IDLE;
+		}
+		break;
+	}
+	return s.envelope;
+}
+
+void AudioSynthModulation::update(void)
+{
+	audio_block_t *block;
+
+	filter.advance();
+	vibrato.advance();
+	const float direct = filterBlend * filterAmount;
+	const float lfoShare = 1.0f - filterBlend;
+
+	for (int v=0; v < voiceCount; v++) {
+		ModulationState &s = state[v];
+		if (targets[v]) targets[v]->gate();
+
+		bool pitchMoved = s.resend;
+		bool expressionMoved = s.resend;
+		s.resend = false;
+		float ratio = 1.0f + vibrato.read(offset[v]);
+		if (ratio != s.vibratoRatio) {
+			s.vibratoRatio = ratio;
+			pitchMoved = true;
+		}
+		// the master bend glides with the note's own, so s.bend is the sum
+		if (glide(s.bend, s.bendTarget + masterSemitones, 0.001f)) {
+			s.bendRatio = exp2f(s.bend * (1.0f / 12.0f));
+			pitchMoved = true;
+		}
+		expressionMoved |= glide(s.pressure, s.pressureTarget, 0.0005f);
+		expressionMoved |= glide(s.timbre, s.timbreTarget, 0.001f);
+		if (targets[v]) {
+			if (pitchMoved) targets[v]->modulatePitch(s.vibratoRatio, s.bendRatio);
+			if (expressionMoved) targets[v]->modulateExpression(s.pressure, s.timbre);
+		}
+
+		float value = direct + lfoShare * filter.read(offset[v]) * stepEnvelope(s);
+		if (value > 1.0f) value = 1.0f;
+		if (value < -1.0f) value = -1.0f;
+		int32_t from = s.filterOutput;
+		int32_t to = value * 32767.0f;
+		s.filterOutput = to;
+		// nothing to send is silence, which the filter envelope passes on
+		if (from == 0 && to == 0) continue;
+
+		block = allocate();
+		if (!block) continue;
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			block->data[i] = from + (((to - from) * (i + 1)) >> 7);
+		}
+		transmit(block, v);
+		release(block);
+	}
+}
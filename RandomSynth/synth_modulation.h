@@ -0,0 +1,260 @@
+#pragma once
+#ifndef synth_modulation_h_
+#define synth_modulation_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "synth_waveform.h"
+
+// A low frequency oscillator stepped once per audio block rather than every
+// sample. Its phase is a 32 bit accumulator like AudioSynthWaveform's, and
+// read() can look at it from a different point in the cycle, so one LFO can
+// drive several voices out of step.
+class ControlLfo {
+public:
+  // WAVEFORM_SINE, TRIANGLE, SAWTOOTH, SAWTOOTH_REVERSE, SQUARE or
+  // SAMPLE_HOLD; anything else plays a sine
+  void begin(short type) {
+    shape = type;
+  }
+  void frequency(float freq) {
+    if (freq < 0.0f) freq = 0.0f;
+    // a block is the shortest step, so cap it at four blocks a cycle
+    float limit = AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES / 4.0f;
+    if (freq > limit) freq = limit;
+    increment = freq * (4294967296.0f * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT);
+  }
+  void amplitude(float n) {
+    level = n;
+  }
+  void advance() {
+    uint32_t next = phase + increment;
+    if (next < phase) cycles++;
+    phase = next;
+  }
+  // -amplitude to amplitude, at the current phase plus offset (a 32 bit
+  // fraction of a cycle)
+  float read(uint32_t offset = 0) const;
+
+private:
+  uint32_t phase = 0;
+  uint32_t increment = 0;
+  uint32_t cycles = 0;  // for sample and hold
+  float level = 1.0f;
+  short shape = WAVEFORM_SINE;
+};
+
+// A voice's share of the modulation each block: the depth envelope on the
+// filter LFO, how far it has got, and the last value sent, then the note's
+// own expression, where it is heading and where it has got
+struct ModulationState {
+  uint8_t stage = 0;  // idle, delay, attack, decay, sustain, release
+  uint32_t count = 0;  // blocks left in a timed stage
+  float envelope = 0;
+  float releaseStep = 0;
+  int16_t filterOutput = 0;
+  float vibratoRatio = 1.0f;
+  float bendTarget = 0;  // semitones
+  float bend = 0;  // semitones, with the master bend
+  float bendRatio = 1.0f;
+  float pressureTarget = -1, pressure = -1;  // -1 until the note has any
+  float timbreTarget = 0, timbre = 0;
+  bool resend = false;  // a new note is told everything
+};
+
+// Told of the vibrato and the note's expression once a block when they
+// move, from inside the audio update
+class ModulationTarget {
+public:
+  // Pitch multipliers, 1 for none
+  virtual void modulatePitch(float vibrato, float bend) = 0;
+  // Pressure 0 to 1, or -1 while the note has had none; timbre (MPE's
+  // CC 74) -1 to 1, 0 at rest
+  virtual void modulateExpression(float pressure, float timbre) = 0;
+  // Every block, before the voice renders, so a voice that has finished
+  // can take itself out of the graph
+  virtual void gate() {}
+};
+
+// The per voice LFOs of the synth as control-rate state, where they were an
+// AudioSynthWaveform, an envelope and a mixer per voice before.
+//
+// The vibrato LFO moves each voice's pitch through its ModulationTarget,
+// along with the note's expression: per note pitch bend, pressure and
+// timbre. Those are set from MIDI as targets, any number of times a block,
+// and each block every voice glides part of the way there, so the voice
+// hears of them once a block at most and without steps.
+//
+// The filter LFO, shaped per voice by a DADSR depth envelope and blended
+// with the filter envelope amount, comes out of output i for voice i as a
+// ramp from the last block's value, for the filter envelope to shape.
+class AudioSynthModulation : public AudioStream {
+public:
+  virtual void update(void);
+
+  // Voice is told of the vibrato on voice index
+  void attach(int voice, ModulationTarget *target) {
+    targets[voice] = target;
+  }
+
+  void noteOn(int voice);
+  void noteOff(int voice);
+
+  ControlLfo &filterLfo() {
+    return filter;
+  }
+  ControlLfo &vibratoLfo() {
+    return vibrato;
+  }
+
+  // Pitch swings by up to this share of itself, 0 for none
+  void vibratoDepth(float depth) {
+    vibrato.amplitude(depth);
+  }
+
+  // Per note expression for a voice: bend in semitones, pressure 0 to 1,
+  // timbre -1 to 1
+  void pitchBend(int voice, float semitones) {
+    state[voice].bendTarget = semitones;
+  }
+  void pressure(int voice, float amount) {
+    ModulationState &s = state[voice];
+    // a note's first pressure takes hold at once, there being nothing to
+    // glide from
+    if (s.pressure < 0) {
+      s.pressure = amount;
+      s.resend = true;
+    }
+    s.pressureTarget = amount;
+  }
+  void timbre(int voice, float amount) {
+    state[voice].timbreTarget = amount;
+  }
+  // All three at once for a note starting, which takes them without a
+  // glide; pressure -1 if the note has none yet
+  void expression(int voice, float semitones, float pressure, float timbre);
+  // Bend for every voice, on top of their own
+  void masterBend(float semitones) {
+    masterSemitones = semitones;
+  }
+  // Time for expression to get about two thirds of the way to a new value
+  void expressionGlide(float milliseconds) {
+    float n = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f) / AUDIO_BLOCK_SAMPLES;
+    glideRate = n > 1.0f ? 1.0f / n : 1.0f;
+  }
+
+  // Where in the cycle each voice reads an LFO, in cycles
+  void phaseOffset(int voice, float cycles) {
+    offset[voice] = cycles * 4294967296.0f;
+  }
+
+  // -1 to 1, the filter envelope depth, as AudioSynthWaveformDc did
+  void envelopeAmount(float amount) {
+    filterAmount = amount;
+  }
+  // Share of the filter envelope amount against the LFO, 1 for no LFO
+  void blend(float share) {
+    filterBlend = share;
+  }
+
+  // The filter LFO depth envelope, as on AudioEffectEnvelope
+  void delay(float milliseconds) {
+    delayBlocks = blocks(milliseconds);
+  }
+  void attack(float milliseconds) {
+    attackStep = 1.0f / (blocks(milliseconds) + 1);
+  }
+  void decay(float milliseconds) {
+    decayStep = 1.0f / (blocks(milliseconds) + 1);
+  }
+  void sustain(float level) {
+    sustainLevel = level < 0.0f ? 0.0f : level > 1.0f ? 1.0f : level;
+  }
+  void release(float milliseconds) {
+    releaseBlocks = blocks(milliseconds) + 1;
+  }
+  using AudioStream::release;
+
+  int voices() {
+    return voiceCount;
+  }
+
+  // Updates with no cords out, which a node otherwise does not, for voices
+  // that take only the vibrato and expression
+  void keepRunning() {
+    active = true;
+  }
+
+protected:
+  AudioSynthModulation(int voiceCount, ModulationState *state, ModulationTarget **targets, uint32_t *offset)
+    : AudioStream(0, NULL), voiceCount(voiceCount), state(state), targets(targets), offset(offset) {
+    delay(0.0f);
+    attack(10.5f);
+    decay(35.0f);
+    release(300.0f);
+    expressionGlide(10.0f);
+  }
+
+private:
+  static uint32_t blocks(float milliseconds) {
+    float n = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f) / AUDIO_BLOCK_SAMPLES;
+    return n > 0.0f ? (uint32_t)(n + 0.5f) : 0;
+  }
+  float stepEnvelope(ModulationState &s);
+  bool glide(float &value, float target, float snap) {
+    if (value == target) return false;
+    value += (target - value) * glideRate;
+    if (fabsf(target - value) < snap) value = target;
+    return true;
+  }
+
+  int voiceCount;
+  ModulationState *state;
+  ModulationTarget **targets;
+  uint32_t *offset;
+  ControlLfo filter;
+  ControlLfo vibrato;
+  float filterAmount = 0;
+  float filterBlend = 1.0f;
+  uint32_t delayBlocks = 0;
+  float attackStep = 1.0f;
+  float decayStep = 1.0f;
+  float sustainLevel = 0.5f;
+  uint32_t releaseBlocks = 1;
+  float masterSemitones = 0;
+  float glideRate = 1.0f;
+};
+
+template<int numVoices>
+class AudioSynthModulationBank : public AudioSynthModulation {
+public:
+  AudioSynthModulationBank()
+    : AudioSynthModulation(numVoices, stateArray, targetArray, offsetArray) {}
+
+private:
+  ModulationState stateArray[numVoices];
+  ModulationTarget *targetArray[numVoices] = {};
+  uint32_t offsetArray[numVoices] = {};
+};
+
+// One voice of a bank, so a voice can use it without knowing the bank size
+class ModulationVoice {
+public:
+  void attach(AudioSynthModulation *modulation, int index, ModulationTarget *target) {
+    this->modulation = modulation;
+    this->index = index;
+    modulation->attach(index, target);
+  }
+  void noteOn() {
+    if (modulation) modulation->noteOn(index);
+  }
+  void noteOff() {
+    if (modulation) modulation->noteOff(index);
+  }
+
+private:
+  AudioSynthModulation *modulation = NULL;
+  int index = 0;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include <Arduino.h>
+#include "synth_wavetablemorph.h"
+#include "utility/dspinst.h"
+
+// Pitch multiplier for one frequency modulation sample, 1.0 = 0x10000,
+// exactly as AudioSynthWaveformModulated computes it
+static inline uint32_t modulationScale(int16_t in, uint32_t modulationFactor)
+{
+	int32_t n = in * modulationFactor; // n is # of octaves to mod
+	int32_t ipart = n >> 27; // 4 integer bits
+	n &= 0x7FFFFFF;          // 27 fractional bits
+	// exp2 algorithm by Laurent de Soras
+	// https://www.musicdsp.org/en/latest/Other/106-fast-exp2-approximation.html
+	n = (n + 134217728) << 3;
+	n = multiply_32x32_rshift32_rounded(n, n);
+	n = multiply_32x32_rshift32_rounded(n, 715827883) << 3;
+	n = n + 715827882;
+	return n >> (14 - ipart);
+}
+
+static inline uint32_t modulatedStep(uint32_t inc, uint32_t scale)
+{
+	uint64_t phstep = (uint64_t)inc * scale;
+	return (phstep >> 32) < 0x7FFE ? (uint32_t)(phstep >> 16) : 0x7FFE0000;
+}
+
+// Phase of every sample in the block. Modulated phases are advanced before
+// use and unmodulated ones after, as AudioSynthWaveformModulated does.
+static uint32_t blockPhases(uint32_t *phase, uint32_t ph, uint32_t inc, const uint32_t *scale)
+{
+	if (scale) {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			ph += modulatedStep(inc, scale[i]);
+			phase[i] = ph;
+		}
+	} else {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			phase[i] = ph;
+			ph += inc;
+		}
+	}
+	return ph;
+}
+
+static inline int16_t tableSample(const int16_t *table, uint32_t index, int32_t scale, int32_t inverse, int32_t magnitude)
+{
+	return multiply_32x32_rshift32(table[index] * inverse + table[index + 1] * scale, magnitude);
+}
+
+// Both tables at each phase, linearly interpolated like WAVEFORM_ARBITRARY.
+// The two reads share the index and fraction.
+static void readTables(int16_t *outStart, int16_t *outEnd, const int16_t *startTable,
+	const int16_t *endTable, const uint32_t *phase, int32_t magnitude)
+{
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		uint32_t ph = phase[i];
+		uint32_t index = ph >> 24;
+		int32_t scale = (ph >> 8) & 0xFFFF;
+		int32_t inverse = 0x10000 - scale;
+		outStart[i] = tableSample(startTable, index, scale, inverse, magnitude);
+		outEnd[i] = tableSample(endTable, index, scale, inverse, magnitude);
+	}
+}
+
+// The same for scanned rows, where each sample reads its own pair
+static void readRows(int16_t *outLow, int16_t *outHigh, const int16_t *const *rows, int level,
+	const uint16_t *row, const uint32_t *phase, int32_t magnitude)
+{
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		uint32_t ph = phase[i];
+		uint32_t index = ph >> 24;
+		int32_t scale = (ph >> 8) & 0xFFFF;
+		int32_t inverse = 0x10000 - scale;
+		outLow[i] = tableSample(rows[row[i]] + level, index, scale, inverse, magnitude);
+		outHigh[i] = tableSample(rows[row[i] + 1] + level, index, scale, inverse, magnitude);
+	}
+}
+
+// Mipmap level for a phase increment. Level k keeps 128 >> k harmonics,
+// which stay under Nyquist while the increment is below 2^(24 + k).
+static inline int mipmapLevel(uint32_t inc, int levels)
+{
+	int level = 0;
+	for (uint32_t octaves = inc >> 24; octaves; octaves >>= 1) level++;
+	return level < levels ? level : levels - 1;
+}
+
+// Lower row and Q14 row weights for each sample: the position ramp plus
+// whatever arrives on input 1, held to the rows there are
+void AudioSynthWavetableMorph::scanWeights(uint16_t *row, int16_t *weight0, int16_t *weight1, const audio_block_t *modulation)
+{
+	int32_t from = currentPosition;
+	int32_t to = targetPosition;
+	currentPosition = to;
+	const int32_t last = (scanCount - 1) << 16;
+
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t pos = from + (((to - from) * (i + 1)) >> 7);
+		if (modulation) pos += (modulation->data[i] * positionFactor) >> 7;
+		int32_t r = pos >> 16;
+		int32_t w = (pos & 0xFFFF) >> 2;
+		if (pos < 0) {
+			r = 0;
+			w = 0;
+		} else if (pos >= last) {
+			// the top row is the upper half of the last pair
+			r = scanCount - 2;
+			w = 16384;
+		}
+		row[i] = r;
+		weight0[i] = 16384 - w;
+		weight1[i] = w;
+	}
+}
+
+void AudioSynthWavetableMorph::update(void)
+{
+	audio_block_t *moddata, *posdata, *mix, *start, *end;
+	uint32_t scale[AUDIO_BLOCK_SAMPLES];
+	uint32_t phase[AUDIO_BLOCK_SAMPLES];
+	int16_t secondStart[AUDIO_BLOCK_SAMPLES];
+	int16_t secondEnd[AUDIO_BLOCK_SAMPLES];
+	int16_t weight0[AUDIO_BLOCK_SAMPLES];
+	int16_t weight1[AUDIO_BLOCK_SAMPLES];
+	uint16_t row[AUDIO_BLOCK_SAMPLES];
+	const int16_t *const *rows = scanRows;
+	const int32_t mag = magnitude;
+
+	// Both accumulators take the same pitch multiplier per sample
+	const uint32_t *modulation = NULL;
+	moddata = receiveReadOnly(0);
+	if (moddata) {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			scale[i] = modulationScale(moddata->data[i], modulationFactor);
+		}
+		release(moddata);
+		modulation = scale;
+	}
+
+	posdata = receiveReadOnly(1);
+	if (rows) scanWeights(row, weight0, weight1, posdata);
+	if (posdata) release(posdata);
+
+	uint32_t from = currentWeights;
+	uint32_t to = targetWeights;
+	currentWeights = to;
+
+	mix = start = end = NULL;
+	if (mag != 0 && (rows || (startTable && endTable))) {
+		mix = allocate();
+		start = allocate();
+		end = allocate();
+	}
+	if (!mix || !start || !end) {
+		// No output, but the phases still move on
+		phaseAccumulator[0] = blockPhases(phase, phaseAccumulator[0], phaseIncrement[0], modulation);
+		phaseAccumulator[1] = blockPhases(phase, phaseAccumulator[1], phaseIncrement[1], modulation);
+		if (mix) release(mix);
+		if (start) release(start);
+		if (end) release(end);
+		return;
+	}
+
+	// Each accumulator picks its band-limited copy once per block
+	const int levels = mipmaps;
+	const int level0 = mipmapLevel(phaseIncrement[0], levels) * 257;
+	const int level1 = mipmapLevel(phaseIncrement[1], levels) * 257;
+
+	phaseAccumulator[0] = blockPhases(phase, phaseAccumulator[0], phaseIncrement[0], modulation);
+	if (rows) {
+		readRows(start->data, end->data, rows, level0, row, phase, mag);
+	} else {
+		readTables(start->data, end->data, startTable + level0, endTable + level0, phase, mag);
+	}
+	phaseAccumulator[1] = blockPhases(phase, phaseAccumulator[1], phaseIncrement[1], modulation);
+	if (rows) {
+		readRows(secondStart, secondEnd, rows, level1, row, phase, mag);
+	} else {
+		readTables(secondStart, secondEnd, startTable + level1, endTable + level1, phase, mag);
+
+		// Morph weights step in 16.16 and each sample takes the top half,
+		// the same ramp AudioInterpolate makes
+		int32_t acc0 = (from & 0xFFFF) << 16;
+		int32_t acc1 = from & 0xFFFF0000;
+		const int32_t step0 = ((int32_t)(to & 0xFFFF) - (int32_t)(from & 0xFFFF)) << 9;
+		const int32_t step1 = ((int32_t)(to >> 16) - (int32_t)(from >> 16)) << 9;
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			weight0[i] = (uint32_t)(acc0 + (i + 1) * step0) >> 16;
+			weight1[i] = (uint32_t)(acc1 + (i + 1) * step1) >> 16;
+		}
+	}
+
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t w0 = weight0[i];
+		int32_t w1 = weight1[i];
+		int32_t first = signed_saturate_rshift(start->data[i] * w0 + end->data[i] * w1, 16, 14);
+		int32_t second = signed_saturate_rshift(secondStart[i] * w0 + secondEnd[i] * w1, 16, 14);
+		// both accumulators at half gain, rounding down like AudioMixer4
+		mix->data[i] = saturate16((first >> 1) + (second >> 1));
+	}
+
+	transmit(mix, 0);
+	transmit(start, 1);
+	transmit(end, 2);
+	release(mix);
+	release(start);
+	release(end);
+}
@@ -0,0 +1,147 @@
+#pragma once
+#ifndef synth_wavetablemorph_h_
+#define synth_wavetablemorph_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "utility/dspinst.h"
+
+// The voice's wavetable section in one object: two phase accumulators, each
+// reading a start and an end table, morphed and mixed. It sounds the same as
+// four AudioSynthWaveformModulated oscillators feeding two AudioInterpolate
+// objects and a mixer at 0.5 each, sample for sample.
+//
+// With scanWaveforms() the start and end tables give way to a list of rows,
+// and a fractional position picks two adjacent rows to blend, so every table
+// in the list sits on one continuous morph.
+//
+// Input 0 is frequency modulation, as on AudioSynthWaveformModulated, and
+// input 1 moves the scan position. Output 0 is the mix, outputs 1 and 2 the
+// two tables being morphed at the first accumulator's phase, for modulating
+// other oscillators.
+class AudioSynthWavetableMorph : public AudioStream {
+public:
+  AudioSynthWavetableMorph()
+    : AudioStream(2, inputQueueArray) {}
+
+  virtual void update(void);
+
+  // 257 sample tables like those in wavetables.h, the last repeating the first
+  void startWaveform(const int16_t *data) {
+    startTable = data;
+  }
+  void endWaveform(const int16_t *data) {
+    endTable = data;
+  }
+
+  // Tables that are each followed by levels - 1 band-limited copies, as
+  // WavetableCache unpacks them. Each accumulator then reads the richest
+  // copy that does not alias at its pitch. 1, the default, plays tables as
+  // they are.
+  void mipmapLevels(int levels) {
+    mipmaps = levels < 1 ? 1 : levels;
+  }
+
+  // Scans count rows, each a table that can live anywhere, followed by its
+  // band-limited copies if mipmapLevels() is set. The array is read as the
+  // audio runs, so its entries can be repointed, but it has to outlive the
+  // scan. NULL goes back to the start and end tables.
+  void scanWaveforms(const int16_t *const *rows, int count) {
+    // update() must never see the new count with the old rows
+    __disable_irq();
+    scanCount = count;
+    scanRows = count >= 2 ? rows : NULL;
+    position(scanPosition);
+    __enable_irq();
+  }
+
+  // Row to play, 0 to count - 1; between rows the two are blended. A change
+  // ramps in across the next block.
+  void position(float row) {
+    scanPosition = row;
+    float last = scanRows ? scanCount - 1 : 0;
+    if (row < 0.0f) row = 0.0f;
+    if (row > last) row = last;
+    targetPosition = row * 65536.0f;
+  }
+
+  // Full scale on input 1 moves the position this many rows either way
+  void positionModulation(float rows) {
+    if (rows < 0.0f) rows = 0.0f;
+    if (rows > 127.0f) rows = 127.0f;
+    positionFactor = rows * 256.0f;
+  }
+
+  // Both accumulators at the same pitch
+  void frequency(float freq) {
+    frequency(freq, 1.0f);
+  }
+
+  // The first accumulator runs at freq / detune, the second at freq * detune
+  void frequency(float freq, float detune) {
+    phaseIncrement[0] = increment(freq / detune);
+    phaseIncrement[1] = increment(freq * detune);
+  }
+
+  void amplitude(float n) {  // 0 to 1.0
+    if (n < 0) {
+      n = 0;
+    } else if (n > 1.0f) {
+      n = 1.0f;
+    }
+    magnitude = n * 65536.0f;
+  }
+
+  // 0 plays the start tables, 1 the end tables. A change ramps in across
+  // the next block.
+  void morph(float factor) {
+    if (factor < 0.0f) factor = 0.0f;
+    if (factor > 1.0f) factor = 1.0f;
+    // one 32 bit store, so update() never sees half of a change
+    targetWeights = ((uint32_t)(factor * 16384.0f + 0.5f) << 16) | (uint32_t)((1.0f - factor) * 16384.0f + 0.5f);
+  }
+
+  // Full scale on input 0 shifts the pitch by this many octaves
+  void frequencyModulation(float octaves) {
+    if (octaves > 12.0f) {
+      octaves = 12.0f;
+    } else if (octaves < 0.1f) {
+      octaves = 0.1f;
+    }
+    modulationFactor = octaves * 4096.0f;
+  }
+
+private:
+  static uint32_t increment(float freq) {
+    if (freq < 0.0f) {
+      freq = 0.0;
+    } else if (freq > AUDIO_SAMPLE_RATE_EXACT / 2.0f) {
+      freq = AUDIO_SAMPLE_RATE_EXACT / 2.0f;
+    }
+    uint32_t inc = freq * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+    return inc > 0x7FFE0000u ? 0x7FFE0000u : inc;
+  }
+
+  void scanWeights(uint16_t *row, int16_t *weight0, int16_t *weight1, const audio_block_t *modulation);
+
+  audio_block_t *inputQueueArray[2];
+  const int16_t *startTable = NULL;
+  const int16_t *endTable = NULL;
+  const int16_t *const *scanRows = NULL;
+  int scanCount = 0;
+  float scanPosition = 0;
+  // Q16 rows, ramped like the morph weights
+  volatile int32_t targetPosition = 0;
+  int32_t currentPosition = 0;
+  int32_t positionFactor = 256;
+  int mipmaps = 1;
+  uint32_t phaseAccumulator[2] = {};
+  uint32_t phaseIncrement[2] = {};
+  uint32_t modulationFactor = 32768;
+  int32_t magnitude = 0;
+  // Q14 morph weights, end table in the top half and start in the bottom
+  volatile uint32_t targetWeights = 0x20002000;
+  uint32_t currentWeights = 0x20002000;
+};
+
+#endif
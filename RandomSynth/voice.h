@@ -6,8 +6,9 @@
 #include <Arduino.h>
 #include <Audio.h>
 #include "synth_karplusstronger.h"
-#include "interpolate.h"
-#include "AudioInputToInt.h"
+#include "synth_wavetablemorph.h"
+#include "synth_modulation.h"
+#include <type_traits>
 
 #define STRING 0
 #define SINE 1
@@ -16,32 +17,93 @@
 
 AudioInputI2S mic;
 
-class Voice {
+// Stands in for a node a voice policy leaves out. It takes the calls the
+// node would and ignores them, so code driving a voice need not know its
+// policy, and it is not an AudioStream: nothing is added to the update
+// list and it takes no RAM beyond a byte.
+struct AbsentNode {
+  template<typename... Args> void attach(Args...) {}
+  template<typename... Args> void begin(Args...) {}
+  template<typename... Args> void noteOn(Args...) {}
+  template<typename... Args> void noteOff(Args...) {}
+  template<typename... Args> void mute(Args...) {}
+  template<typename... Args> void resume(Args...) {}
+  template<typename... Args> void setPitch(Args...) {}
+  template<typename... Args> void decay(Args...) {}
+  template<typename... Args> void brightness(Args...) {}
+  template<typename... Args> void gain(Args...) {}
+  template<typename... Args> void frequency(Args...) {}
+  template<typename... Args> void amplitude(Args...) {}
+  template<typename... Args> void frequencyModulation(Args...) {}
+  template<typename... Args> void resonance(Args...) {}
+  template<typename... Args> void octaveControl(Args...) {}
+  template<typename... Args> void delay(Args...) {}
+  template<typename... Args> void attack(Args...) {}
+  template<typename... Args> void hold(Args...) {}
+  template<typename... Args> void sustain(Args...) {}
+  template<typename... Args> void release(Args...) {}
+  template<typename... Args> void morph(Args...) {}
+  template<typename... Args> void startWaveform(Args...) {}
+  template<typename... Args> void endWaveform(Args...) {}
+  template<typename... Args> void scanWaveforms(Args...) {}
+  template<typename... Args> void position(Args...) {}
+  template<typename... Args> void mipmapLevels(Args...) {}
+  bool isActive() {
+    return false;
+  }
+  bool isSounding() {
+    return false;
+  }
+};
+
+// A node when `present`, else an AbsentNode in its place
+template<bool present, class Node>
+using Part = typename std::conditional<present, Node, AbsentNode>::type;
+
+// What a voice is built from, chosen at compile time: which of the STRING,
+// SINE and WAVETABLE sources it has, fm for the FM mixer and envelope that
+// drive the sine's pitch (only with the sine), filterLfo for the filter
+// envelope and the modulation bank's filter LFO through it, and the filter
+// type, AbsentNode for none. The vibrato LFO and per note expression reach
+// every voice, as they cost no nodes.
+struct FullVoice {
+  static constexpr bool string = true;
+  static constexpr bool sine = true;
+  static constexpr bool wavetable = true;
+  static constexpr bool fm = true;
+  static constexpr bool filterLfo = true;
+  typedef AudioFilterLadder Filter;
+};
+
+// The wavetable through the ladder filter and nothing else
+struct WavetableVoice {
+  static constexpr bool string = false;
+  static constexpr bool sine = false;
+  static constexpr bool wavetable = true;
+  static constexpr bool fm = false;
+  static constexpr bool filterLfo = false;
+  typedef AudioFilterLadder Filter;
+};
+
+template<class Policy>
+class BasicVoice : public ModulationTarget {
+  static constexpr bool hasFm = Policy::fm && Policy::sine;
+  static constexpr bool hasFilter = !std::is_same<typename Policy::Filter, AbsentNode>::value;
+  static constexpr bool hasFilterLfo = Policy::filterLfo && hasFilter;
+
 public:
-  AudioSynthKarplusStronger string;
-  AudioAmplifier stringAmplitude;
-  AudioSynthWaveformModulated sine;
-  AudioMixer4 fmModulator;
-  AudioSynthWaveformModulated oscillatorOne;
-  AudioSynthWaveformModulated oscillatorTwo;
-  AudioSynthWaveformModulated oscillatorThree;
-  AudioSynthWaveformModulated oscillatorFour;
-  AudioSynthWaveform lfo;
-  AudioSynthWaveform lfo2;
-  AudioEffectEnvelope lfo2Envelope;
-  AudioMixer4 filterModBlend;
+  Part<Policy::string, KarplusStrongString> string;  // rendered by a shared bank, see connectString()
+  Part<Policy::string, AudioAmplifier> stringAmplitude;
+  Part<Policy::sine, AudioSynthWaveformModulated> sine;
+  Part<hasFm, AudioMixer4> fmModulator;
+  Part<Policy::wavetable, AudioSynthWavetableMorph> wavetable;
+  ModulationVoice modulation;  // LFOs, run by a shared bank, see connectModulation()
   AudioMixer4 voiceMixer;
-  AudioMixer4 waveMixer;
-  AudioFilterLadder voiceFilter;
-  AudioEffectEnvelope filterEnvelope;
+  typename Policy::Filter voiceFilter;
+  Part<hasFilterLfo, AudioEffectEnvelope> filterEnvelope;
   AudioEffectEnvelope voiceEnvelope;
-  AudioEffectEnvelope fmEnvelope;
-  AudioSynthWaveformDc filterAmount;
-  AudioInterpolate interpolator[2];
+  Part<hasFm, AudioEffectEnvelope> fmEnvelope;
   AudioAmplifier filterAttenuation;
-  AudioInputToInt reader;
-  AudioInputToInt lfo3Reader;
-  AudioSynthWaveform lfo3;
 
   bool isSustain = false;
   char oscOneIndex = 0;
@@ -57,94 +119,136 @@ public:
 
   PitchParameters pitchParams;
 
-  // Connections within a voice
-  AudioConnection* patchCords[25];
-
-  Voice() {
-    patchCords[0] = new AudioConnection(fmModulator, 0, fmEnvelope, 0);
-    patchCords[1] = new AudioConnection(fmEnvelope, 0, sine, 0);
-    patchCords[2] = new AudioConnection(string, 0, fmModulator, 0);
-    patchCords[3] = new AudioConnection(sine, 0, fmModulator, 1);
-    patchCords[4] = new AudioConnection(oscillatorOne, 0, fmModulator, 2);
-    patchCords[5] = new AudioConnection(oscillatorTwo, 0, fmModulator, 3);
-
-    patchCords[6] = new AudioConnection(string, 0, stringAmplitude, 0);
-    patchCords[7] = new AudioConnection(stringAmplitude, 0, voiceMixer, 0);
-    patchCords[8] = new AudioConnection(sine, 0, voiceMixer, 1);
-    patchCords[9] = new AudioConnection(oscillatorOne, 0, interpolator[0], 0);
-    patchCords[10] = new AudioConnection(oscillatorTwo, 0, interpolator[0], 1);
-    patchCords[11] = new AudioConnection(oscillatorThree, 0, interpolator[1], 0);
-    patchCords[12] = new AudioConnection(oscillatorFour, 0, interpolator[1], 1);
-
-    patchCords[13] = new AudioConnection(interpolator[0], 0, waveMixer, 0);
-    patchCords[14] = new AudioConnection(interpolator[1], 0, waveMixer, 1);
-    patchCords[15] = new AudioConnection(waveMixer, 0, voiceMixer, 2);
-    patchCords[16] = new AudioConnection(voiceMixer, 0, voiceFilter, 0);
-    patchCords[17] = new AudioConnection(filterAmount, 0, filterModBlend, 0);
-    patchCords[18] = new AudioConnection(lfo2, 0, lfo2Envelope, 0);
-    // patchCords[18] = new AudioConnection(lfo2, 0, voiceFilter, 1);
-    patchCords[19] = new AudioConnection(lfo2Envelope, 0, filterModBlend, 1);
-    patchCords[20] = new AudioConnection(filterModBlend, 0, filterEnvelope, 0);
-    patchCords[21] = new AudioConnection(filterEnvelope, 0, voiceFilter, 1);
-    patchCords[22] = new AudioConnection(voiceFilter, 0, filterAttenuation, 0);
-    patchCords[22] = new AudioConnection(filterAttenuation, 0, voiceEnvelope, 0);
-    patchCords[23] = new AudioConnection(lfo, reader);
-    patchCords[24] = new AudioConnection(lfo3, lfo3Reader);
-
-    lfo.begin(WAVEFORM_TRIANGLE);
-    lfo.frequency(2);
-    lfo.amplitude(1);
-
-    lfo2.begin(WAVEFORM_TRIANGLE);
-    lfo2.frequency(10);
-    lfo2.amplitude(1);
-
-    oscillatorOne.begin(WAVEFORM_ARBITRARY);
-    oscillatorTwo.begin(WAVEFORM_ARBITRARY);
-    oscillatorThree.begin(WAVEFORM_ARBITRARY);
-    oscillatorFour.begin(WAVEFORM_ARBITRARY);
+  // Connections within a voice, and in and out of it. Those to or from a
+  // node the policy leaves out are NULL.
+  AudioConnection* patchCords[16];
+
+  BasicVoice() {
+    patchCords[0] = patch(fmModulator, 0, fmEnvelope, 0);
+    patchCords[1] = patch(fmEnvelope, 0, sine, 0);
+    patchCords[2] = NULL;  // string cords are made by connectString()
+    patchCords[3] = patch(sine, 0, fmModulator, 1);
+    patchCords[4] = patch(wavetable, 1, fmModulator, 2);
+    patchCords[5] = patch(wavetable, 2, fmModulator, 3);
+
+    patchCords[6] = NULL;
+    patchCords[7] = patch(stringAmplitude, 0, voiceMixer, 0);
+    patchCords[8] = patch(sine, 0, voiceMixer, 1);
+    patchCords[9] = patch(wavetable, 0, voiceMixer, 2);
+    patchCords[10] = patch(voiceMixer, 0, voiceFilter, 0);
+    patchCords[11] = NULL;  // the filter modulation cord is made by connectModulation()
+    patchCords[12] = patch(filterEnvelope, 0, voiceFilter, 1);
+    patchCords[13] = patch(voiceFilter, 0, filterAttenuation, 0);
+    if (!hasFilter) patchCords[13] = new AudioConnection(voiceMixer, 0, filterAttenuation, 0);
+    patchCords[14] = new AudioConnection(filterAttenuation, 0, voiceEnvelope, 0);
+    patchCords[15] = NULL;  // the output cord is made by connectOutput()
+
     sine.begin(WAVEFORM_SINE);
     // sine.amplitude(1);
 
-    fmModulator.gain(STRING, 0.0);
-    fmModulator.gain(SINE, 0.0);
-    fmModulator.gain(WAVETABLE, 0.0);
+    fmGain(STRING, 0.0);
+    fmGain(SINE, 0.0);
+    fmGain(WAVETABLE, 0.0);
 
-    waveMixer.gain(0, 0.5);
-    waveMixer.gain(1, 0.5);
-
-    voiceMixer.gain(STRING, 0.0);
-    voiceMixer.gain(SINE, 0.0);
-    voiceMixer.gain(WAVETABLE, 0.0);
+    mixGain(STRING, 0.0);
+    mixGain(SINE, 0.0);
+    mixGain(WAVETABLE, 0.0);
+    applyCords();  // nothing is heard yet
 
     sine.frequency(1);
     sine.amplitude(1);
 
-    oscillatorOne.frequencyModulation(1);
-    oscillatorTwo.frequencyModulation(1);
-    oscillatorThree.frequencyModulation(1);
-    oscillatorFour.frequencyModulation(1);
+    wavetable.frequencyModulation(1);
     sine.frequencyModulation(1);
   }
 
+  // Plays string `index` of a bank. The bank has to be constructed before
+  // the voice so it renders first in each audio update.
+  void connectString(AudioSynthKarplusStrongStrings &strings, int index) {
+    string.attach(&strings, index);
+    patchCords[2] = patch(strings, index, fmModulator, 0);
+    patchCords[6] = patch(strings, index, stringAmplitude, 0);
+    applyCords();
+  }
+  // A Synth whose policy has no string has no bank either
+  void connectString(AbsentNode &, int) {}
+
+  // Takes its LFOs from voice `index` of a bank, which has to be constructed
+  // before the voice like the strings
+  void connectModulation(AudioSynthModulation &bank, int index) {
+    modulation.attach(&bank, index, this);
+    patchCords[11] = patch(bank, index, filterEnvelope, 0);
+    // the vibrato and expression still need the bank to update
+    if (!patchCords[11]) bank.keepRunning();
+  }
+
+  void connectOutput(AudioStream &mixer, int channel) {
+    patchCords[15] = new AudioConnection(voiceEnvelope, 0, mixer, channel);
+    applyCords();
+  }
+
+  // Gains of STRING, SINE and WAVETABLE into the voice mixer, and into the
+  // FM mixer that drives the sine's frequency. A source heard neither way
+  // has its cords taken out, so it stops rendering; raising its gain puts
+  // them back, the oscillators carrying on from where they stopped. A
+  // string taken out is silent until the next note plucks it.
+  void mixGain(int source, float gain) {
+    voiceMixer.gain(source, gain);
+    mixGains[source] = gain;
+    updateSources();
+  }
+  void fmGain(int source, float gain) {
+    fmModulator.gain(source, gain);
+    fmGains[source] = gain;
+    updateSources();
+  }
+
+  // Bits (1 << STRING, SINE, WAVETABLE) of the sources the output hears
+  uint8_t sourcesInUse() {
+    return sources;
+  }
+
+  // Called by the modulation bank once a block, ahead of the voice's own
+  // nodes. Once the voice envelope has finished, every cord in and out of
+  // the voice comes out of the graph, which leaves each node with no
+  // connections and so inactive: none of them update until noteOn(). The
+  // string, rendered by the shared bank, is muted, or it would ring on
+  // unheard until it decayed.
+  void gate() {
+    if (!suspended && !isActive()) {
+      suspended = true;
+      string.mute();
+      applyCords();
+    }
+  }
+
+  bool isSuspended() {
+    return suspended;
+  }
+
   void noteOn(float noteFrequency, float velocity) {
     float amplitude = velocity / 127;
     pitchParams.baseFrequency = noteFrequency;
-    string.noteOn(noteFrequency, 1);
+    stringPlucked = sources & (1 << STRING);
+    if (stringPlucked) {
+      string.noteOn(noteFrequency, 1);
+    } else {
+      string.noteOff(0);
+    }
     stringAmplitude.gain(amplitude);
     sine.frequency(noteFrequency);
     sine.amplitude(amplitude);
-    oscillatorOne.begin(amplitude, noteFrequency, WAVEFORM_ARBITRARY);
-    oscillatorTwo.begin(amplitude, noteFrequency, WAVEFORM_ARBITRARY);
-    oscillatorThree.begin(amplitude, noteFrequency, WAVEFORM_ARBITRARY);
-    oscillatorFour.begin(amplitude, noteFrequency, WAVEFORM_ARBITRARY);
+    wavetable.amplitude(amplitude);
+    wavetable.frequency(noteFrequency);
 
     voiceEnvelope.noteOn();
     filterEnvelope.noteOn();
     fmEnvelope.noteOn();
-    lfo2Envelope.noteOn();
+    modulation.noteOn();
     isSustain = true;
     lastUsedTimestamp = millis();
+    // after the envelope has started, so gate() cannot take it out again
+    resume();
   }
 
   void noteOff() {
@@ -153,25 +257,21 @@ public:
     voiceEnvelope.noteOff();
     filterEnvelope.noteOff();
     fmEnvelope.noteOff();
-    lfo2Envelope.noteOff();
+    modulation.noteOff();
   }
 
   void setAmplitude(float input) {
     float amplitude = input / 127;
     stringAmplitude.gain(amplitude);
     sine.amplitude(amplitude);
-    oscillatorOne.amplitude(amplitude);
-    oscillatorTwo.amplitude(amplitude);
-    oscillatorThree.amplitude(amplitude);
-    oscillatorFour.amplitude(amplitude);
+    wavetable.amplitude(amplitude);
     Serial.println(amplitude);
   }
 
 
 
   void wavetableMorph(float value) {
-    interpolator[0].setInterpolationFactor(value);
-    interpolator[1].setInterpolationFactor(value);
+    wavetable.morph(value);
   }
 
   bool isActive() {
@@ -183,49 +283,136 @@ public:
   }
 
   void updateOscillatorFrequencies() {
-    float baseFreq = pitchParams.baseFrequency * pow(2.0, pitchParams.octaveOffset);  // Base frequency with octave offset
+    float baseFreq = ldexpf(pitchParams.baseFrequency, pitchParams.octaveOffset);  // Base frequency with octave offset
     // float vibratoEffect = 1.0 + (sin(lfoPhase) * vibratoDepth);                       // LFO-based vibrato effect                        // Pitch bend effect
 
     // Apply vibrato and pitch bend uniformly to base frequency
     baseFreq *= pitchParams.vibratoAmount * pitchParams.pitchBend;
     // baseFreq *= pitchParams.pitchBend;
 
-    // Apply detuning to oscillator 2
-    float freqOsc1 = baseFreq / pitchParams.detuneAmount;  // Oscillator 1 frequency
-    float freqOsc2 = baseFreq * pitchParams.detuneAmount;  // Oscillator 2 frequency with detuning
-
-    oscillatorOne.frequency(freqOsc1);
-    oscillatorTwo.frequency(freqOsc1);
-    oscillatorThree.frequency(freqOsc2);
-    oscillatorFour.frequency(freqOsc2);
+    // Detune the two wavetable oscillators apart
+    wavetable.frequency(baseFreq, pitchParams.detuneAmount);
     sine.frequency(baseFreq);
     string.setPitch(baseFreq);
   }
 
-  void updateVibrato() {
-    pitchParams.vibratoAmount = 1 + ((float)reader.getIntValue() / 1000000);
-    Serial.println(reader.getIntValue());
-    updateOscillatorFrequencies();
+  // Called by the modulation bank each block the vibrato or bend moves. A
+  // voice that is not sounding only keeps them for its next note.
+  void modulatePitch(float vibrato, float bend) {
+    pitchParams.vibratoAmount = vibrato;
+    pitchParams.pitchBend = bend;
+    if (isActive()) updateOscillatorFrequencies();
   }
 
-  void vibratoOff() {
-    pitchParams.vibratoAmount = 1;
+  // Likewise for the note's pressure, which morphs the wavetables as
+  // aftertouch always has, and timbre, which moves the filter up to two
+  // octaves either way. Until a note has pressure the morph stays where it
+  // was, half way at rest.
+  void modulateExpression(float pressure, float timbre) {
+    if (pressure >= 0) wavetableMorph(pressure);
+    timbreScale = exp2f(timbre * 2.0f);
+    voiceFilter.frequency(filterCutoff * timbreScale);
   }
 
-  // Apply a pitch bend, then recalculate oscillator frequencies
-  void applyPitchBend(float bendAmount) {
-    pitchParams.pitchBend = bendAmount;  // Pitch bend amount in semitones
-    Serial.println(pitchParams.pitchBend);
-    updateOscillatorFrequencies();
+  // These two are called from loop(), and the modulation bank retunes the
+  // same nodes from the audio update, so each holds it off for the moment
+  // it takes, or it could write a stale timbre or vibrato back
+  void setFilterFrequency(float frequency) {
+    AudioNoInterrupts();
+    filterCutoff = frequency;
+    voiceFilter.frequency(frequency * timbreScale);
+    AudioInterrupts();
   }
 
   void applyDetune(float detune) {
+    AudioNoInterrupts();
     pitchParams.detuneAmount = detune;
     updateOscillatorFrequencies();
+    AudioInterrupts();
   }
 
   // Additional methods for voice control can be added here
 private:
+  void resume() {
+    if (!suspended) return;
+    AudioNoInterrupts();
+    suspended = false;
+    applyCords();
+    AudioInterrupts();
+  }
+
+  // Which sources are heard. The sine hears the FM mixer only while it is
+  // heard itself, and mixer channel 3 (the wavetable's end table) keeps the
+  // unity gain AudioMixer4 starts with. A string that stops being heard
+  // is muted in the bank, so turning it back up mid note brings it back
+  // where it stopped; one the note never plucked is plucked then.
+  void updateSources() {
+    bool sineHeard = Policy::sine && mixGains[SINE] != 0;
+    bool fmHeard = hasFm && sineHeard && (fmGains[STRING] != 0 || fmGains[SINE] != 0 || fmGains[WAVETABLE] != 0 || fmGains[3] != 0);
+    bool stringHeard = Policy::string && (mixGains[STRING] != 0 || (fmHeard && fmGains[STRING] != 0));
+    bool wavetableHeard = Policy::wavetable && (mixGains[WAVETABLE] != 0 || (fmHeard && (fmGains[WAVETABLE] != 0 || fmGains[3] != 0)));
+    uint8_t used = (stringHeard << STRING) | (sineHeard << SINE) | (wavetableHeard << WAVETABLE) | (fmHeard << FM_SOURCE);
+    if (used == sources) return;
+    sources = used;
+    AudioNoInterrupts();
+    if (!stringHeard) {
+      string.mute();
+    } else if (isActive() && !stringPlucked) {
+      stringPlucked = true;
+      string.noteOn(pitchParams.baseFrequency, 1);
+      updateOscillatorFrequencies();
+    } else if (isActive()) {
+      string.resume();
+    }
+    applyCords();
+    AudioInterrupts();
+  }
+
+  // What each cord needs heard to be connected; the rest always are
+  bool cordWanted(int cord) {
+    static const uint8_t S = 1 << STRING, N = 1 << SINE, W = 1 << WAVETABLE, F = 1 << FM_SOURCE;
+    static const uint8_t needs[16] = {
+      F, F, F | S, F, F | W, F | W,  // the FM mixer and what feeds it
+      S, S, N, W,  // sources into the voice mixer
+      0, 0, 0, 0, 0, 0
+    };
+    return !suspended && (sources & needs[cord]) == needs[cord];
+  }
+  void applyCords() {
+    for (int i = 0; i < 16; i++) {
+      if (!patchCords[i]) continue;
+      if (cordWanted(i)) {
+        patchCords[i]->connect();
+      } else {
+        patchCords[i]->disconnect();
+      }
+    }
+  }
+
+  // A cord between two nodes, or none when the policy leaves either out
+  static AudioConnection *patch(AudioStream &source, int output, AudioStream &destination, int input) {
+    return new AudioConnection(source, output, destination, input);
+  }
+  static AudioConnection *patch(AudioStream &, int, AbsentNode &, int) {
+    return NULL;
+  }
+  static AudioConnection *patch(AbsentNode &, int, AudioStream &, int) {
+    return NULL;
+  }
+  static AudioConnection *patch(AbsentNode &, int, AbsentNode &, int) {
+    return NULL;
+  }
+
+  static const int FM_SOURCE = 3;  // a bit in sources, for the FM mixer
+  volatile bool suspended = false;
+  uint8_t sources = 0;
+  bool stringPlucked = false;  // this note, so turning it up can pluck it late
+  float mixGains[3] = { 0, 0, 0 };
+  float fmGains[4] = { 0, 0, 0, 1 };
 
   unsigned long lastUsedTimestamp;
+  float filterCutoff = 1000;  // before timbre, as AudioFilterLadder starts
+  float timbreScale = 1;
 };
+
+typedef BasicVoice<FullVoice> Voice;
@@ -0,0 +1,84 @@
+#include <Arduino.h>
+#include "wavetable_cache.h"
+
+bool PackedWavetables::read(int table, int16_t *out) {
+  if (table < 0 || table >= tableCount) return false;
+  for (int level = 0; level < levelCount; level++) {
+    WavetableCache::unpack(tables[table * levelCount + level], out + level * 257);
+  }
+  return true;
+}
+
+void WavetableCache::begin(WavetableSource *source, int16_t *memory, uint32_t samples) {
+  this->source = source;
+  this->memory = memory;
+  levels = source ? source->levels() : 1;
+  uint32_t fit = samples / (levels * 257);
+  numSlots = fit < WAVETABLE_CACHE_MAX_SLOTS ? fit : WAVETABLE_CACHE_MAX_SLOTS;
+  for (int i = 0; i < WAVETABLE_CACHE_MAX_SLOTS; i++) {
+    slotTable[i] = -1;
+    slotUsed[i] = 0;
+  }
+  clock = 0;
+  missCount = 0;
+  lastLoad = 0;
+  maxLoad = 0;
+}
+
+const int16_t *WavetableCache::find(int table) const {
+  for (int i = 0; i < numSlots; i++) {
+    if (slotTable[i] == table) return memory + i * levels * 257;
+  }
+  return NULL;
+}
+
+// The slot holding the table, else the least recently used one
+int WavetableCache::slotFor(int table) const {
+  int slot = 0;
+  for (int i = 0; i < numSlots; i++) {
+    if (slotTable[i] == table) return i;
+    // empty slots have never been used, so they go first
+    if (slotUsed[i] < slotUsed[slot]) slot = i;
+  }
+  return slot;
+}
+
+const int16_t *WavetableCache::victim(int table) const {
+  if (!loadable(table)) return NULL;
+  int slot = slotFor(table);
+  return slotTable[slot] == table ? NULL : memory + slot * levels * 257;
+}
+
+const int16_t *WavetableCache::load(int table) {
+  if (!loadable(table)) return NULL;
+
+  int slot = slotFor(table);
+  if (slotTable[slot] == table) {
+    slotUsed[slot] = ++clock;
+    return memory + slot * levels * 257;
+  }
+
+  uint32_t started = micros();
+  int16_t *out = memory + slot * levels * 257;
+  slotTable[slot] = -1;
+  bool ok = source->read(table, out);
+  lastLoad = micros() - started;
+  if (lastLoad > maxLoad) maxLoad = lastLoad;
+  missCount++;
+  if (!ok) return NULL;
+  slotTable[slot] = table;
+  slotUsed[slot] = ++clock;
+  return out;
+}
+
+void WavetableCache::unpack(const PackedWavetable &packed, int16_t *table) {
+  int32_t sample = packed.first;
+  table[0] = sample;
+  for (int n = 1; n < 256; n++) {
+    int block = n >> 3;
+    int shift = (packed.shifts[block >> 1] >> ((block & 1) * 4)) & 15;
+    sample += packed.delta[n - 1] * (1 << shift);
+    table[n] = sample;
+  }
+  table[256] = table[0];  // guard sample for interpolation
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <Arduino.h>
+
+#define WAVETABLE_CACHE_MAX_SLOTS 16
+
+// One band-limited level of a 256 sample wavetable, delta coded in a little
+// over half the flash: each sample is the one before plus delta << shift,
+// with a 4 bit shift for every 8 samples, so only the blocks holding a steep
+// edge lose any precision. Made by extras/host/wavetable_mipmaps.cpp.
+struct PackedWavetable {
+  int16_t first;
+  uint8_t shifts[16];  // block b in the low nibble of shifts[b / 2] if b is even
+  int8_t delta[255];
+};
+
+// Where a WavetableCache gets its tables: the packed arrays compiled into
+// flash, or a WavetableFile for libraries too big for that.
+class WavetableSource {
+public:
+  virtual ~WavetableSource() {}
+  virtual int count() = 0;
+  virtual int levels() = 0;
+  // Every level of a table, levels() * 257 samples. False if it cannot be
+  // read.
+  virtual bool read(int table, int16_t *out) = 0;
+};
+
+// Tables packed into flash by extras/host/wavetable_mipmaps.cpp, table-major
+class PackedWavetables : public WavetableSource {
+public:
+  PackedWavetables(const PackedWavetable *tables, int count, int levels)
+    : tables(tables), tableCount(count), levelCount(levels) {}
+
+  int count() {
+    return tableCount;
+  }
+  int levels() {
+    return levelCount;
+  }
+  bool read(int table, int16_t *out);
+
+private:
+  const PackedWavetable *tables;
+  int tableCount;
+  int levelCount;
+};
+
+// Unpacks the wavetables a patch uses into RAM, where the oscillators read
+// them faster than from flash or a card, and keeps the most recently used
+// ones so flipping between a few tables reads nothing.
+//
+// load() and find() are meant for patch changes in loop(), never the audio
+// update. A table stays unpacked until `slots` other tables have been loaded
+// after it, so keep fewer tables than that in use at once.
+class WavetableCache {
+public:
+  // memory holds as many tables as fit, each source->levels() * 257 samples
+  void begin(WavetableSource *source, int16_t *memory, uint32_t samples);
+
+  // All levels of a table, one 257 sample table after another, as
+  // AudioSynthWavetableMorph::mipmapLevels() expects. NULL if out of range
+  // or unreadable.
+  const int16_t *load(int table);
+
+  // The table if it is unpacked already, else NULL. Does not count as a use.
+  const int16_t *find(int table) const;
+
+  // The slot load(table) would unpack over, or NULL if it would read
+  // nothing. Oscillators still reading that slot have to be moved off it
+  // first.
+  const int16_t *victim(int table) const;
+
+  int count() {
+    return source ? source->count() : 0;
+  }
+  // Where the tables come from, as passed to begin()
+  WavetableSource *library() const {
+    return source;
+  }
+  int slots() const {
+    return numSlots;
+  }
+  uint32_t misses() const {
+    return missCount;
+  }
+  // Time taken by the last and the slowest load that had to read a table
+  uint32_t lastLoadMicros() const {
+    return lastLoad;
+  }
+  uint32_t maxLoadMicros() const {
+    return maxLoad;
+  }
+
+  static void unpack(const PackedWavetable &packed, int16_t *table);
+
+private:
+  bool loadable(int table) const {
+    return source && memory && numSlots > 0 && table >= 0 && table < source->count();
+  }
+  int slotFor(int table) const;
+
+  WavetableSource *source = NULL;
+  int levels = 1;
+  int16_t *memory = NULL;
+  int numSlots = 0;
+  int16_t slotTable[WAVETABLE_CACHE_MAX_SLOTS];  // -1 while empty
+  uint32_t slotUsed[WAVETABLE_CACHE_MAX_SLOTS];
+  uint32_t clock = 0;
+  uint32_t missCount = 0;
+  uint32_t lastLoad = 0;
+  uint32_t maxLoad = 0;
+};
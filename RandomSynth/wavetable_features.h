@@ -0,0 +1,147 @@
+#pragma once
+#include "wavetable_index.h"
+
+// Generated from wavetables.h by extras/host/wavetable_mipmaps.cpp, do not
+// edit. { centroid, { bands }, { neighbours } } for each table.
+
+const WavetableFeatures wavetableFeatures[128] = {
+  { 1057, {   0, 190,  26,  33,   7,   0 }, {  90, 127,  89,  52 } },
+  { 1138, {   6,  35, 213,   0,   0,   0 }, {   2,   3,  32,  64 } },
+  {  987, {   6,  33, 216,   0,   0,   0 }, {   3,   1,  24,  64 } },
+  {  977, {   4,  77, 166,   6,   2,   0 }, {   2,  52, 127,  64 } },
+  {  293, { 243,   9,   3,   0,   0,   0 }, {  61,  96,  10,   9 } },
+  {  279, { 244,  11,   0,   0,   0,   0 }, {  10,  61,   9,  68 } },
+  {  260, { 254,   1,   1,   0,   0,   0 }, {  78,  91, 107, 105 } },
+  {  312, { 210,  42,   2,   0,   0,   0 }, {  15, 116, 121,  53 } },
+  { 2162, {  83,  64,  57,  16,  17,  18 }, {  62,  64,  46,  77 } },
+  {  274, { 246,   8,   1,   0,   0,   0 }, {  61,   5,  10,  45 } },
+  {  283, { 243,  11,   1,   0,   0,   0 }, {   5,   9,  61,  68 } },
+  {  532, { 135, 101,  17,   1,   1,   0 }, {  25,  56,  71,  88 } },
+  {  364, { 189,  60,   6,   1,   0,   0 }, {  22,  53,  41,  94 } },
+  {  259, { 254,   1,   0,   0,   0,   0 }, {  60, 105,  39, 103 } },
+  {  285, { 244,   5,   5,   0,   0,   0 }, {  10,  59,   9,  61 } },
+  {  319, { 215,  32,   7,   0,   0,   0 }, { 116,   7,  53, 121 } },
+  {  272, { 251,   1,   3,   0,   0,   0 }, {  67,   6,  91, 105 } },
+  {  330, { 218,  35,   1,   0,   0,   0 }, {  42,  69, 120, 122 } },
+  {  276, { 246,   8,   0,   0,   0,   0 }, {  80, 115,  27,  75 } },
+  {  303, { 230,  20,   5,   0,   0,   0 }, { 126,  96,  70,  59 } },
+  {  277, { 244,   9,   1,   1,   0,   0 }, {  85,  54,  81,  35 } },
+  {  261, { 252,   3,   0,   0,   0,   0 }, { 103,  85,  74,  13 } },
+  {  416, { 180,  57,  15,   2,   0,   0 }, {  94, 124, 125,  98 } },
+  { 3826, {   0,   1,  28, 125,  98,   3 }, { 108,  28,  89,  46 } },
+  { 1202, {   0,  40, 190,  24,   0,   0 }, {   2,   3,   1,  64 } },
+  {  502, { 153,  96,   4,   2,   1,   0 }, { 120, 122,  11,  56 } },
+  { 13851, {   0,   0,   0,   1,  14, 240 }, {  28,   8, 108,  46 } },
+  {  280, { 245,   9,   0,   0,   0,   0 }, {  18,  80, 115,  75 } },
+  { 13583, {   1,   4,   3,  26,  77, 144 }, {  26,  23, 108,   8 } },
+  {  462, {  74, 181,   0,   0,   0,   0 }, {  58, 117,  79,  33 } },
+  {  680, { 125,  55,  69,   6,   0,   0 }, {  31,  88,  76, 101 } },
+  {  680, { 125,  55,  69,   6,   0,   0 }, {  30,  88,  76, 101 } },
+  {  796, {  63,  95,  93,   4,   0,   0 }, {  64,  30,  31,   8 } },
+  {  550, {  65, 179,  11,   1,   0,   0 }, { 117,  29,  84,  41 } },
+  {  417, { 179,  46,  30,   0,   0,   0 }, {  84, 112,  36,  22 } },
+  {  268, { 246,   7,   2,   0,   0,   0 }, {  54, 102,  92,  44 } },
+  {  515, { 157,  24,  74,   0,   0,   0 }, {  34, 114, 112, 113 } },
+  {  342, { 243,   0,   0,  12,   0,   0 }, {  38,  40,  39,  13 } },
+  {  335, { 244,   0,   0,  11,   0,   0 }, {  37,  40,  39,  13 } },
+  {  258, { 255,   0,   0,   0,   0,   0 }, {  40, 105,  48, 106 } },
+  {  259, { 254,   0,   0,   0,   0,   0 }, {  39,  48, 105, 106 } },
+  {  371, { 165,  88,   2,   0,   0,   0 }, {  12,  84,  22,   7 } },
+  {  312, { 227,  28,   0,   0,   0,   0 }, {  17,  68,  50,  69 } },
+  {  679, {  41, 210,   3,   0,   0,   0 }, {  55,  11,  25,  33 } },
+  {  268, { 244,  11,   0,   0,   0,   0 }, { 104, 102,  92,  54 } },
+  {  266, { 250,   4,   0,   0,   0,   0 }, {  75,  91,  80,   9 } },
+  { 1690, {  98,  51,  48,  34,  16,   8 }, {  62,   8,  76,  77 } },
+  {  763, {   0, 174,  81,   0,   0,   0 }, {  57,  49, 118,  52 } },
+  {  256, { 255,   0,   0,   0,   0,   0 }, { 106,  39,  66, 107 } },
+  { 1486, {  21, 150,  41,  20,  16,   7 }, {  47, 127, 117,  57 } },
+  {  334, { 216,  38,   0,   0,   0,   0 }, { 120, 122,  42,  17 } },
+  {  473, { 186,  44,  17,   5,   2,   0 }, {  97,  98, 111,  93 } },
+  {  717, {   7, 169,  77,   2,   0,   0 }, { 127,   3, 117,  64 } },
+  {  348, { 209,  36,  10,   1,   0,   0 }, {  15,  70,  22,  12 } },
+  {  267, { 246,   8,   0,   0,   0,   0 }, {  85, 102,  20,  35 } },
+  {  737, {  21, 232,   2,   0,   0,   0 }, {  43,  25,  90,  11 } },
+  {  364, { 201,  50,   4,   0,   0,   0 }, {  17,  42,  83, 120 } },
+  {  531, {   0, 251,   3,   0,   0,   0 }, { 118,  47, 117,  52 } },
+  {  402, { 120, 135,   0,   0,   0,   0 }, {  79,  29,  41, 117 } },
+  {  286, { 241,   9,   5,   0,   0,   0 }, {  96,  20,   9,  61 } },
+  {  257, { 254,   1,   0,   0,   0,   0 }, {  13, 105, 103,  66 } },
+  {  277, { 244,  11,   1,   0,   0,   0 }, {   9,   5,  10,  68 } },
+  { 1128, { 136,  49,  39,  14,  10,   6 }, {  76,  93,  77, 101 } },
+  {  291, { 236,  15,   3,   1,   0,   0 }, {  92,  99,  35,  54 } },
+  { 1275, {  34, 118,  74,  17,   7,   5 }, {  32,   8, 127,   3 } },
+  {  331, { 230,  18,   6,   1,   0,   0 }, {  95, 109, 123, 110 } },
+  {  257, { 255,   0,   0,   0,   0,   0 }, { 107,  78, 106,  48 } },
+  {  266, { 252,   1,   2,   0,   0,   0 }, {  16,   6,  91,  78 } },
+  {  292, { 236,  18,   1,   0,   0,   0 }, {   5,  10,  61,  42 } },
+  {  314, { 231,  21,   3,   0,   0,   0 }, { 123, 119,  95,  42 } },
+  {  320, { 228,  19,   8,   1,   0,   0 }, { 126,  96,  19,  53 } },
+  {  626, { 149,  52,  48,   6,   0,   0 }, {  87, 100, 110, 109 } },
+  {  300, { 252,   2,   0,   0,   0,   1 }, {  74, 103,  13,  21 } },
+  {  271, { 252,   2,   1,   1,   0,   0 }, { 103,  13,  21, 105 } },
+  {  270, { 253,   2,   0,   0,   0,   0 }, { 103,  72,  60,  21 } },
+  {  267, { 250,   4,   1,   0,   0,   0 }, {  91,  80,  45,  18 } },
+  {  733, { 143,  56,  37,  16,   3,   0 }, { 101,  93, 111,  98 } },
+  {  881, { 144,  57,  35,   4,  12,   3 }, {  93, 101,  98, 111 } },
+  {  258, { 254,   1,   0,   0,   0,   0 }, { 107,  66,  91, 105 } },
+  {  384, { 129, 125,   0,   0,   0,   0 }, {  58,  86,  41,  29 } },
+  {  271, { 248,   7,   0,   0,   0,   0 }, {  18, 115,  75,  27 } },
+  {  290, { 244,   7,   2,   2,   0,   0 }, {  20,  85,  99,  35 } },
+  {  799, {  81,  94,  29,  51,   0,   0 }, { 113, 114,  86, 117 } },
+  {  378, { 222,  27,   3,   2,   1,   0 }, {  69,  17,  42, 123 } },
+  {  396, { 167,  76,  12,   0,   0,   0 }, {  41,  12,  34,  22 } },
+  {  269, { 247,   7,   0,   0,   0,   0 }, {  54,  20,  21, 102 } },
+  {  421, { 134, 100,  20,   0,   0,   0 }, {  79, 114,  58,  41 } },
+  {  376, { 213,  28,  13,   1,   0,   0 }, { 109, 110, 100,  65 } },
+  {  460, { 161,  65,  26,   2,   0,   0 }, {  94, 111, 124, 125 } },
+  { 1514, {   0, 111,  52,  88,   1,   3 }, {   0, 127,  90,  64 } },
+  {  884, {   0, 206,  42,   4,   1,   1 }, {   0,  64,  43,  89 } },
+  {  261, { 253,   2,   0,   0,   0,   0 }, {  78,   6, 107,  75 } },
+  {  276, { 239,  15,   1,   0,   0,   0 }, {  44,  63, 104,  35 } },
+  {  514, { 166,  59,  22,   7,   1,   0 }, { 101, 111,  94,  98 } },
+  {  441, { 174,  59,  19,   4,   0,   0 }, { 124, 125,  22, 111 } },
+  {  308, { 234,  17,   4,   0,   0,   0 }, { 119,  65, 123,  69 } },
+  {  292, { 238,  13,   4,   0,   0,   0 }, { 126,  19,  59,  70 } },
+  {  494, { 196,  37,  14,   5,   2,   1 }, {  51,  98,  22,  53 } },
+  {  490, { 179,  51,  17,   5,   2,   0 }, { 111, 124, 125,  93 } },
+  {  286, { 244,   5,   5,   1,   0,   0 }, {  81,  35,  73,  63 } },
+  {  408, { 216,  23,  11,   4,   1,   0 }, { 110, 109,  87,  65 } },
+  {  511, { 166,  59,  22,   7,   1,   0 }, {  93, 111,  94, 124 } },
+  {  269, { 247,   7,   0,   0,   0,   0 }, {  54,  44, 104,  85 } },
+  {  258, { 254,   1,   0,   0,   0,   0 }, {  60,  13,  74, 105 } },
+  {  268, { 243,  12,   0,   0,   0,   0 }, {  44, 102,  92,  54 } },
+  {  259, { 254,   0,   0,   0,   0,   0 }, {  13,  39,  60, 107 } },
+  {  256, { 255,   0,   0,   0,   0,   0 }, {  48,  66,  39, 107 } },
+  {  257, { 255,   0,   0,   0,   0,   0 }, {  66,  78, 106,  48 } },
+  { 2928, {  90,  25,  41,  42,  33,  23 }, {  71, 100, 110, 109 } },
+  {  384, { 219,  23,  10,   3,   0,   0 }, { 110, 100,  87,  65 } },
+  {  393, { 218,  23,  11,   3,   0,   0 }, { 109, 100,  87,  65 } },
+  {  490, { 168,  59,  21,   6,   1,   0 }, {  93, 101,  94, 124 } },
+  {  474, { 183,  34,  27,  10,   0,   0 }, {  51,  34,  94,  97 } },
+  {  661, { 137,  43,  52,  21,   0,   1 }, { 114,  82, 112,  36 } },
+  {  474, { 165,  50,  33,   7,   0,   0 }, { 124, 125,  94, 112 } },
+  {  276, { 245,   9,   1,   0,   0,   0 }, {  18,  80,  27,  75 } },
+  {  325, { 216,  30,   8,   1,   0,   0 }, {  15, 121,  63,   7 } },
+  {  505, {  64, 177,  14,   0,   0,   0 }, {  29,  33,  58,  86 } },
+  {  516, {   0, 254,   1,   0,   0,   0 }, {  57,  47,  29, 117 } },
+  {  299, { 236,  17,   2,   0,   0,   0 }, {  95,  69, 123, 115 } },
+  {  348, { 212,  42,   1,   0,   0,   0 }, { 122,  50,  17,  42 } },
+  {  320, { 209,  40,   6,   0,   0,   0 }, { 116,  15,   7,  63 } },
+  {  348, { 212,  42,   1,   0,   0,   0 }, { 120,  50,  17,  42 } },
+  {  317, { 233,  17,   5,   1,   0,   0 }, {  69, 119,  95,  65 } },
+  {  438, { 176,  58,  17,   4,   0,   0 }, { 125,  94,  22, 111 } },
+  {  438, { 176,  58,  17,   4,   0,   0 }, { 124,  94,  22, 111 } },
+  {  304, { 231,  20,   4,   0,   0,   0 }, {  96,  19,  70,  61 } },
+  {  910, {   7, 156,  72,  16,   4,   0 }, {  52,   3,  64, 117 } }
+};
+
+const uint16_t wavetablesByCentroid[128] = {
+  48, 106, 60, 66, 107, 39, 78, 103, 13, 40, 105, 6, 21, 91, 45, 67,
+  54, 75, 35, 44, 104, 85, 102, 74, 73, 80, 16, 9, 18, 92, 115, 20,
+  61, 5, 27, 10, 14, 59, 99, 81, 63, 68, 96, 4, 119, 72, 19, 126,
+  95, 7, 42, 69, 123, 15, 70, 121, 116, 17, 65, 50, 38, 37, 53, 120,
+  122, 12, 56, 41, 87, 83, 79, 109, 110, 84, 58, 100, 22, 34, 86, 124,
+  125, 94, 88, 29, 51, 112, 114, 98, 111, 97, 25, 117, 101, 93, 36, 118,
+  57, 11, 33, 71, 113, 43, 30, 31, 52, 76, 55, 47, 32, 82, 77, 90,
+  127, 3, 2, 0, 62, 1, 24, 64, 49, 89, 46, 8, 108, 23, 28, 26
+};
@@ -0,0 +1,111 @@
+#include <Arduino.h>
+#include "wavetable_file.h"
+#ifdef RANDOMSYNTH_HOST
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Records are read straight into the struct, which both the Teensy and the
+// host lay out with one byte of padding after delta
+static_assert(sizeof(PackedWavetable) == 274, "PackedWavetable is not 274 bytes");
+
+static uint32_t littleEndian(const uint8_t *bytes, int n) {
+  uint32_t value = 0;
+  for (int i = n - 1; i >= 0; i--) value = (value << 8) | bytes[i];
+  return value;
+}
+
+// Table and level counts from a header, false if it is not one
+static bool parseHeader(const uint8_t *header, int &count, int &levels) {
+  if (memcmp(header, "RSWT", 4) || littleEndian(header + 4, 2) != WavetableFile::VERSION) return false;
+  levels = littleEndian(header + 6, 2);
+  uint32_t tables = littleEndian(header + 8, 4);
+  if (levels < 1 || levels > 8 || tables > 0x7FFFFFFF / (levels * sizeof(PackedWavetable))) return false;
+  count = tables;
+  return true;
+}
+
+#ifdef RANDOMSYNTH_HOST
+
+bool WavetableFile::open(const char *path) {
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void *mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= HEADER_BYTES) {
+    mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);  // the mapping keeps the file
+  if (mapped == MAP_FAILED) return false;
+  data = (const uint8_t *)mapped;
+  size = st.st_size;
+
+  int count, levels;
+  if (!parseHeader(data, count, levels) || size < HEADER_BYTES + (size_t)count * levels * sizeof(PackedWavetable)) {
+    close();
+    return false;
+  }
+  tableCount = count;
+  levelCount = levels;
+  return true;
+}
+
+void WavetableFile::close() {
+  if (data) munmap((void *)data, size);
+  data = NULL;
+  size = 0;
+  tableCount = 0;
+  levelCount = 0;
+}
+
+bool WavetableFile::read(int table, int16_t *out) {
+  if (!data || table < 0 || table >= tableCount) return false;
+  // records start at an even offset, so int16_t first is aligned
+  const PackedWavetable *packed = (const PackedWavetable *)(data + HEADER_BYTES) + (size_t)table * levelCount;
+  for (int level = 0; level < levelCount; level++) {
+    WavetableCache::unpack(packed[level], out + level * 257);
+  }
+  return true;
+}
+
+#else
+
+bool WavetableFile::open(const char *path) {
+  close();
+  file = SD.open(path, FILE_READ);
+  if (!file) return false;
+  uint8_t header[HEADER_BYTES];
+  int count, levels;
+  if (file.read(header, HEADER_BYTES) != HEADER_BYTES || !parseHeader(header, count, levels)
+      || file.size() < HEADER_BYTES + (uint64_t)count * levels * sizeof(PackedWavetable)) {
+    close();
+    return false;
+  }
+  tableCount = count;
+  levelCount = levels;
+  return true;
+}
+
+void WavetableFile::close() {
+  if (file) file.close();
+  tableCount = 0;
+  levelCount = 0;
+}
+
+// One seek and a record at a time, so a table costs 274 bytes of stack
+// rather than a buffer for all its levels
+bool WavetableFile::read(int table, int16_t *out) {
+  if (!file || table < 0 || table >= tableCount) return false;
+  if (!file.seek(HEADER_BYTES + (uint64_t)table * levelCount * sizeof(PackedWavetable))) return false;
+  PackedWavetable packed;
+  for (int level = 0; level < levelCount; level++) {
+    if (file.read(&packed, sizeof(packed)) != (int)sizeof(packed)) return false;
+    WavetableCache::unpack(packed, out + level * 257);
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#include <Arduino.h>
+#include "wavetable_cache.h"
+#ifndef RANDOMSYNTH_HOST
+#include <SD.h>
+#endif
+
+// A wavetable library on the SD card (memory mapped on the host), for more
+// tables than fit in flash. Tables are read whole into a WavetableCache, so
+// only those a patch uses take RAM and the audio update never touches the
+// card.
+//
+// The file, little endian, is written by `randomsynth_mipmaps -b`:
+//
+//   "RSWT", uint16 version 1, uint16 levels, uint32 count
+//   count * levels PackedWavetable records of 274 bytes, table-major
+//
+// Every record is the same size, so the header is the whole index.
+class WavetableFile : public WavetableSource {
+public:
+  ~WavetableFile() {
+    close();
+  }
+
+  // False if the file is missing or not a version 1 library
+  bool open(const char *path);
+  void close();
+
+  int count() {
+    return tableCount;
+  }
+  int levels() {
+    return levelCount;
+  }
+  bool read(int table, int16_t *out);
+
+  static const int HEADER_BYTES = 12;
+  static const int VERSION = 1;
+
+private:
+  int tableCount = 0;
+  int levelCount = 0;
+#ifdef RANDOMSYNTH_HOST
+  const uint8_t *data = NULL;
+  size_t size = 0;
+#else
+  File file;
+#endif
+};
@@ -0,0 +1,43 @@
+#include <Arduino.h>
+#include "wavetable_index.h"
+
+void WavetableIndex::begin(const WavetableFeatures *features, const uint16_t *byCentroid, int count) {
+  this->features = features;
+  this->byCentroid = byCentroid;
+  tableCount = count;
+}
+
+int WavetableIndex::lowerBound(int32_t centroid) const {
+  int low = 0;
+  int high = tableCount;
+  while (low < high) {
+    int mid = (low + high) >> 1;
+    if (features[byCentroid[mid]].centroid < centroid) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+int WavetableIndex::brightnessRange(float low, float high, int &first) const {
+  first = lowerBound(ceilf(low * 256.0f));
+  // everything up to and including high
+  int last = lowerBound(floorf(high * 256.0f) + 1);
+  return last > first ? last - first : 0;
+}
+
+int WavetableIndex::pickBrightness(float low, float high) const {
+  int first;
+  int count = brightnessRange(low, high, first);
+  return count ? byCentroid[first + random(count)] : -1;
+}
+
+int WavetableIndex::pickSimilar(int table, int closest) const {
+  if (table < 0 || table >= tableCount) return -1;
+  closest = constrain(closest, 1, WAVETABLE_NEIGHBOURS);
+  if (closest > tableCount - 1) closest = tableCount - 1;
+  if (closest < 1) return table;
+  return features[table].neighbours[random(closest)];
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+
+#define WAVETABLE_BANDS 6
+#define WAVETABLE_NEIGHBOURS 4
+
+// What one table sounds like, from the spectrum of its level 0. Made by
+// extras/host/wavetable_mipmaps.cpp into wavetable_features.h.
+struct WavetableFeatures {
+  uint16_t centroid;  // power weighted mean harmonic, in 1/256ths
+  // Share of the energy, of 255, in harmonics 1, 2-3, 4-7, 8-15, 16-31 and
+  // 32 up
+  uint8_t bands[WAVETABLE_BANDS];
+  uint16_t neighbours[WAVETABLE_NEIGHBOURS];  // most similar spectra, closest first
+};
+
+// Looks tables up by brightness or by likeness to another, so a random
+// patch can morph between related timbres. Brightness is the spectral
+// centroid in harmonics: 1 for a sine, around 4 for a triangle-ish table,
+// 20 and up for the buzzy ones.
+class WavetableIndex {
+public:
+  // byCentroid lists every table, darkest first
+  void begin(const WavetableFeatures *features, const uint16_t *byCentroid, int count);
+
+  int count() const {
+    return tableCount;
+  }
+  float brightness(int table) const {
+    return features[table].centroid / 256.0f;
+  }
+  // The rank-th darkest table
+  int byBrightness(int rank) const {
+    return byCentroid[rank];
+  }
+  int similar(int table, int rank) const {
+    return features[table].neighbours[rank];
+  }
+
+  // Tables from low to high harmonics bright are ranks first to
+  // first + count - 1. Two binary searches.
+  int brightnessRange(float low, float high, int &first) const;
+
+  // A random table from low to high harmonics bright, -1 if there is none
+  int pickBrightness(float low, float high) const;
+
+  // A random one of the closest tables to table, 1 to WAVETABLE_NEIGHBOURS
+  int pickSimilar(int table, int closest = WAVETABLE_NEIGHBOURS) const;
+
+private:
+  // Rank of the first table at least centroid bright
+  int lowerBound(int32_t centroid) const;
+
+  const WavetableFeatures *features = NULL;
+  const uint16_t *byCentroid = NULL;
+  int tableCount = 0;
+};